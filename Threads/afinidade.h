@@ -0,0 +1,422 @@
+/****************************************************************************
+ * Posicionamento das Threads (afinidade de CPU) e da memória compartilhada *
+ *  (nó NUMA) para os programas de Threads, no lugar dos atributos padrão   *
+ *  do pthread_create em que o escalonador leva produtores e consumidores   *
+ *  de um soquete para outro e as linhas de cache do vetor junto.           *
+ *                                                                          *
+ * Políticas (texto em afinidade_configura(), variável AFINIDADE ou '-a'):  *
+ *  nenhuma   - atributos padrão (sem afinidade, memória no primeiro toque) *
+ *  compacta  - Threads em CPUs vizinhas: mesmo nó, núcleo e irmãos SMT     *
+ *              em sequência (compartilham cache)                           *
+ *  espalhada - uma Thread por núcleo físico alternando os nós, irmãos SMT  *
+ *              somente após todos os núcleos                               *
+ *  listas    - CPUs explícitas por papel, ex.:                             *
+ *              'produtor=0-3,8:consumidor=4-7' (papel sem lista não fixa)  *
+ *                                                                          *
+ * A topologia (nó, pacote e núcleo de cada CPU permitida ao processo) vem  *
+ *  de /sys. A main declara os papéis na ordem de criação com               *
+ *  afinidade_papel() e cria cada Thread com afinidade_attr(&attr, papel,   *
+ *  i) em atributos locais de quem cria (destruídos após o pthread_create), *
+ *  a CPU depende somente do papel e do índice (processo recriado volta     *
+ *  para a mesma CPU). afinidade_memoria() prende as páginas do vetor       *
+ *  compartilhado no nó com mais Threads posicionadas (mbind, move as       *
+ *  páginas já tocadas), afinidade_aloca() aloca já no nó.                  *
+ *                                                                          *
+ * ** Somente Linux (sched_setaffinity e mbind por syscall, sem libnuma).   *
+ * ** O programa define _GNU_SOURCE antes do primeiro include.              *
+ *************************************************************************** */
+
+#ifndef AFINIDADE_H
+#define AFINIDADE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#ifndef __linux__
+#error "afinidade.h: somente Linux"
+#endif
+#ifndef CPU_SETSIZE
+#error "afinidade.h: definir _GNU_SOURCE antes do primeiro include do programa"
+#endif
+
+/* Maior número de CPU e de nó considerados */
+#define AFINIDADE_MAX_CPUS  1024
+#define AFINIDADE_MAX_NOS   64
+/* CPUs de cada papel mostradas no relatório */
+#define AFINIDADE_MOSTRA    8
+
+/* Políticas */
+#define AFINIDADE_NENHUMA   0
+#define AFINIDADE_COMPACTA  1
+#define AFINIDADE_ESPALHADA 2
+#define AFINIDADE_LISTAS    3
+
+/* Papéis das Threads */
+#define AFINIDADE_PRODUTOR   0
+#define AFINIDADE_CONSUMIDOR 1
+#define AFINIDADE_LEITOR     2
+#define AFINIDADE_ESCRITOR   3
+#define AFINIDADE_FILOSOFO   4
+#define AFINIDADE_PAPEIS     5
+
+static const char *afinidade_nomes[AFINIDADE_PAPEIS] = {"produtor", "consumidor", "leitor",
+                                                         "escritor", "filosofo"};
+
+static int afinidade_politica = AFINIDADE_NENHUMA;
+static char afinidade_texto[256] = "nenhuma";      /* Política como foi pedida (relatórios) */
+static int afinidade_ordem[AFINIDADE_MAX_CPUS];    /* CPUs na ordem de preenchimento da política */
+static size_t afinidade_num_cpus = 0;
+static int afinidade_no_cpu[AFINIDADE_MAX_CPUS];   /* Nó NUMA de cada CPU */
+static size_t afinidade_num_nos = 1;
+static int afinidade_listas[AFINIDADE_PAPEIS][AFINIDADE_MAX_CPUS];
+static size_t afinidade_tam_lista[AFINIDADE_PAPEIS];
+static size_t afinidade_base[AFINIDADE_PAPEIS];    /* Primeira posição da ordem de cada papel */
+static size_t afinidade_quantidade[AFINIDADE_PAPEIS];
+static size_t afinidade_total = 0;                 /* Threads declaradas */
+static int afinidade_no_memoria = -1, afinidade_erro_mbind = 0;
+
+/* Lê um inteiro de um arquivo de /sys, -1 caso não exista */
+static inline long afinidade_le_sys(const char *caminho)
+{
+    FILE *f = fopen(caminho, "r");
+    long v = -1;
+    if (f)
+    {
+        if (fscanf(f, "%ld", &v) != 1)
+            v = -1;
+        fclose(f);
+    }
+    return v;
+}
+
+/* Lê uma lista de CPUs "0-3,8" em 'v', retorna quantas (para no primeiro caractere fora da lista) */
+static inline size_t afinidade_le_lista(const char *txt, int *v, size_t max)
+{
+    size_t n = 0;
+    long a, b;
+    char *fim;
+
+    while (*txt && n < max)
+    {
+        a = strtol(txt, &fim, 10);
+        if (fim == txt)
+            break;
+        b = a;
+        if (*fim == '-')
+        {
+            txt = fim + 1;
+            b = strtol(txt, &fim, 10);
+            if (fim == txt)
+                break;
+        }
+        for (; a <= b && n < max; a++)
+            if (a >= 0 && a < AFINIDADE_MAX_CPUS)
+                v[n++] = (int)a;
+        if (*fim != ',')
+            break;
+        txt = fim + 1;
+    }
+    return n;
+}
+
+/* Topologia das CPUs permitidas ao processo, ordenadas para a política */
+static inline void afinidade_topologia(int politica)
+{
+    cpu_set_t permitidas;
+    char caminho[128], linha[1024];
+    int cpus[AFINIDADE_MAX_CPUS], nucleo[AFINIDADE_MAX_CPUS];
+    int pacote[AFINIDADE_MAX_CPUS], smt[AFINIDADE_MAX_CPUS], posto[AFINIDADE_MAX_CPUS];
+    long chave[AFINIDADE_MAX_CPUS], t;
+    size_t i, j, n, no;
+    FILE *f;
+
+    for (i = 0; i < AFINIDADE_MAX_CPUS; i++)
+        afinidade_no_cpu[i] = 0;
+    /* Nó de cada CPU pela lista de CPUs de cada nó */
+    afinidade_num_nos = 1;
+    for (no = 0; no < AFINIDADE_MAX_NOS; no++)
+    {
+        snprintf(caminho, sizeof(caminho), "/sys/devices/system/node/node%zu/cpulist", no);
+        if (!(f = fopen(caminho, "r")))
+            continue;
+        if (fgets(linha, sizeof(linha), f))
+        {
+            n = afinidade_le_lista(linha, cpus, AFINIDADE_MAX_CPUS);
+            for (i = 0; i < n; i++)
+                afinidade_no_cpu[cpus[i]] = (int)no;
+        }
+        fclose(f);
+        afinidade_num_nos = no + 1;
+    }
+
+    sched_getaffinity(0, sizeof(permitidas), &permitidas);
+    afinidade_num_cpus = 0;
+    for (i = 0; i < AFINIDADE_MAX_CPUS && i < CPU_SETSIZE; i++)
+    {
+        if (!CPU_ISSET(i, &permitidas))
+            continue;
+        n = afinidade_num_cpus++;
+        afinidade_ordem[n] = (int)i;
+        snprintf(caminho, sizeof(caminho), "/sys/devices/system/cpu/cpu%zu/topology/physical_package_id", i);
+        pacote[n] = (int)afinidade_le_sys(caminho);
+        snprintf(caminho, sizeof(caminho), "/sys/devices/system/cpu/cpu%zu/topology/core_id", i);
+        nucleo[n] = (int)afinidade_le_sys(caminho);
+    }
+    n = afinidade_num_cpus;
+
+    /* Irmão SMT (ordem dentro do núcleo) e posto do núcleo dentro do nó */
+    for (i = 0; i < n; i++)
+    {
+        smt[i] = posto[i] = 0;
+        for (j = 0; j < i; j++)
+        {
+            if (afinidade_no_cpu[afinidade_ordem[j]] != afinidade_no_cpu[afinidade_ordem[i]])
+                continue;
+            if (pacote[j] == pacote[i] && nucleo[j] == nucleo[i])
+                smt[i]++;
+            else if (smt[j] == 0 && (pacote[j] != pacote[i] || nucleo[j] != nucleo[i]))
+                posto[i]++;
+        }
+        /* Irmãos repetem o posto do primeiro do núcleo */
+        for (j = 0; j < i; j++)
+            if (smt[j] == 0 && pacote[j] == pacote[i] && nucleo[j] == nucleo[i] &&
+                afinidade_no_cpu[afinidade_ordem[j]] == afinidade_no_cpu[afinidade_ordem[i]])
+                posto[i] = posto[j];
+    }
+
+    /* Compacta: nó, núcleo e irmãos juntos; espalhada: irmão, núcleo e nó alternando */
+    for (i = 0; i < n; i++)
+    {
+        no = (size_t)afinidade_no_cpu[afinidade_ordem[i]];
+        if (politica == AFINIDADE_ESPALHADA)
+            chave[i] = ((long)smt[i] * AFINIDADE_MAX_CPUS + posto[i]) * AFINIDADE_MAX_NOS + (long)no;
+        else
+            chave[i] = ((long)no * AFINIDADE_MAX_CPUS + posto[i]) * AFINIDADE_MAX_CPUS + smt[i];
+    }
+    /* Ordenação por inserção (poucas CPUs, estável) */
+    for (i = 1; i < n; i++)
+        for (j = i; j > 0 && chave[j - 1] > chave[j]; j--)
+        {
+            t = chave[j], chave[j] = chave[j - 1], chave[j - 1] = t;
+            t = afinidade_ordem[j], afinidade_ordem[j] = afinidade_ordem[j - 1], afinidade_ordem[j - 1] = (int)t;
+        }
+}
+
+/*
+    Configura a política pelo texto (NULL = variável de ambiente AFINIDADE,
+    ausente = nenhuma). Retorna 0 ou -1 caso o texto seja inválido.
+*/
+static inline int afinidade_configura(const char *texto)
+{
+    const char *p, *igual;
+    size_t papel, len, i, j, n;
+
+    if (!texto && !(texto = getenv("AFINIDADE")))
+        texto = "nenhuma";
+    snprintf(afinidade_texto, sizeof(afinidade_texto), "%s", texto);
+    for (papel = 0; papel < AFINIDADE_PAPEIS; papel++)
+        afinidade_tam_lista[papel] = afinidade_quantidade[papel] = afinidade_base[papel] = 0;
+    afinidade_total = 0;
+    afinidade_no_memoria = -1;
+
+    if (!strcmp(texto, "nenhuma"))
+        afinidade_politica = AFINIDADE_NENHUMA;
+    else if (!strcmp(texto, "compacta"))
+        afinidade_politica = AFINIDADE_COMPACTA;
+    else if (!strcmp(texto, "espalhada"))
+        afinidade_politica = AFINIDADE_ESPALHADA;
+    else
+    {
+        /* Listas 'papel=cpus:papel=cpus' */
+        afinidade_politica = AFINIDADE_LISTAS;
+        for (p = texto; *p; p = *p ? p + 1 : p)
+        {
+            if (!(igual = strchr(p, '=')))
+                return afinidade_politica = AFINIDADE_NENHUMA, -1;
+            len = (size_t)(igual - p);
+            for (papel = 0; papel < AFINIDADE_PAPEIS; papel++)
+                if (strlen(afinidade_nomes[papel]) == len && !strncmp(p, afinidade_nomes[papel], len))
+                    break;
+            if (papel == AFINIDADE_PAPEIS)
+                return afinidade_politica = AFINIDADE_NENHUMA, -1;
+            afinidade_tam_lista[papel] = afinidade_le_lista(igual + 1, afinidade_listas[papel],
+                                                            AFINIDADE_MAX_CPUS);
+            if (!(p = strchr(igual, ':')))
+                break;
+        }
+    }
+    afinidade_topologia(afinidade_politica);
+
+    /* Descarta das listas as CPUs não permitidas ao processo (pthread_create falharia) */
+    for (papel = 0; papel < AFINIDADE_PAPEIS; papel++)
+    {
+        for (i = n = 0; i < afinidade_tam_lista[papel]; i++)
+        {
+            for (j = 0; j < afinidade_num_cpus && afinidade_ordem[j] != afinidade_listas[papel][i]; j++)
+                ;
+            if (j < afinidade_num_cpus)
+                afinidade_listas[papel][n++] = afinidade_listas[papel][i];
+        }
+        afinidade_tam_lista[papel] = n;
+    }
+    return 0;
+}
+
+/* Declara 'n' Threads do papel (na ordem de criação, compacta e espalhada continuam a ordem) */
+static inline void afinidade_papel(int papel, size_t n)
+{
+    afinidade_base[papel] = afinidade_total;
+    afinidade_quantidade[papel] = n;
+    afinidade_total += n;
+    afinidade_no_memoria = -1;
+}
+
+/* CPU da Thread 'i' do papel, -1 caso a política não fixe */
+static inline int afinidade_cpu(int papel, size_t i)
+{
+    switch (afinidade_politica)
+    {
+    case AFINIDADE_COMPACTA:
+    case AFINIDADE_ESPALHADA:
+        return afinidade_num_cpus ? afinidade_ordem[(afinidade_base[papel] + i) % afinidade_num_cpus] : -1;
+    case AFINIDADE_LISTAS:
+        return afinidade_tam_lista[papel] ? afinidade_listas[papel][i % afinidade_tam_lista[papel]] : -1;
+    }
+    return -1;
+}
+
+/* Inicia os atributos de quem cria a Thread 'i' do papel (padrão quando não fixa) e os retorna,
+ * cada chamador tem os seus (o controlador do elástico cria Threads junto da main) e os destrói
+ * com pthread_attr_destroy() após o pthread_create */
+static inline pthread_attr_t *afinidade_attr(pthread_attr_t *atributos, int papel, size_t i)
+{
+    int cpu = afinidade_cpu(papel, i);
+    cpu_set_t conjunto;
+
+    pthread_attr_init(atributos);
+    if (cpu < 0)
+        return atributos;
+    CPU_ZERO(&conjunto);
+    CPU_SET(cpu, &conjunto);
+    pthread_attr_setaffinity_np(atributos, sizeof(conjunto), &conjunto);
+    return atributos;
+}
+
+/* Fixa a Thread atual na CPU (nada com -1) */
+static inline void afinidade_fixa(int cpu)
+{
+    cpu_set_t conjunto;
+    if (cpu < 0)
+        return;
+    CPU_ZERO(&conjunto);
+    CPU_SET(cpu, &conjunto);
+    sched_setaffinity(0, sizeof(conjunto), &conjunto);
+}
+
+/* Nó com mais Threads declaradas posicionadas, -1 caso nenhuma seja fixada */
+static inline int afinidade_no(void)
+{
+    size_t contagem[AFINIDADE_MAX_NOS] = {0}, papel, i, maior = 0;
+    int cpu, no = -1;
+
+    if (afinidade_no_memoria >= 0)
+        return afinidade_no_memoria;
+    for (papel = 0; papel < AFINIDADE_PAPEIS; papel++)
+        for (i = 0; i < afinidade_quantidade[papel]; i++)
+            if ((cpu = afinidade_cpu((int)papel, i)) >= 0)
+                contagem[afinidade_no_cpu[cpu]]++;
+    for (i = 0; i < AFINIDADE_MAX_NOS; i++)
+        if (contagem[i] > maior)
+        {
+            maior = contagem[i];
+            no = (int)i;
+        }
+    return afinidade_no_memoria = no;
+}
+
+/* Prende as páginas de [p, p + tam) no nó das Threads (move as já tocadas) */
+static inline void afinidade_memoria(void *p, size_t tam)
+{
+    unsigned long mascara[AFINIDADE_MAX_NOS / (8 * sizeof(unsigned long))] = {0};
+    uintptr_t pagina = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t inicio = (uintptr_t)p & ~(pagina - 1);
+    uintptr_t fim = ((uintptr_t)p + tam + pagina - 1) & ~(pagina - 1);
+    int no = afinidade_no();
+
+    if (no < 0 || !tam)
+        return;
+    mascara[no / (8 * sizeof(unsigned long))] |= 1ul << (no % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind, inicio, fim - inicio, MPOL_PREFERRED, mascara, AFINIDADE_MAX_NOS + 1,
+                MPOL_MF_MOVE))
+        afinidade_erro_mbind = errno;
+}
+
+/* Aloca 'tam' bytes zerados já no nó das Threads (liberar com free) */
+static inline void *afinidade_aloca(size_t tam)
+{
+    size_t pagina = (size_t)sysconf(_SC_PAGESIZE);
+    void *p = aligned_alloc(pagina, (tam + pagina - 1) / pagina * pagina);
+    if (!p)
+        return NULL;
+    afinidade_memoria(p, tam);
+    /* Primeiro toque depois da política do nó */
+    memset(p, 0, tam);
+    return p;
+}
+
+/* Descreve as CPUs de cada papel declarado ("produtor 0 1; consumidor 2 3"), sem vírgulas */
+static inline void afinidade_descreve(char *buf, size_t tam)
+{
+    size_t papel, i, len = 0;
+    int cpu;
+
+    buf[0] = '\0';
+    if (afinidade_politica == AFINIDADE_NENHUMA)
+    {
+        snprintf(buf, tam, "padrao");
+        return;
+    }
+    for (papel = 0; papel < AFINIDADE_PAPEIS && len < tam; papel++)
+    {
+        if (!afinidade_quantidade[papel])
+            continue;
+        len += snprintf(buf + len, tam - len, "%s%s", len ? "; " : "", afinidade_nomes[papel]);
+        for (i = 0; i < afinidade_quantidade[papel] && i < AFINIDADE_MOSTRA && len < tam; i++)
+        {
+            cpu = afinidade_cpu((int)papel, i);
+            if (cpu < 0)
+                len += snprintf(buf + len, tam - len, " livre");
+            else
+                len += snprintf(buf + len, tam - len, " %d", cpu);
+        }
+        if (i < afinidade_quantidade[papel] && len < tam)
+            len += snprintf(buf + len, tam - len, " ...");
+    }
+}
+
+/* Imprime política, topologia, CPUs de cada papel e nó da memória */
+static inline void afinidade_relatorio(void)
+{
+    char cpus[512];
+    int no = afinidade_no();
+
+    afinidade_descreve(cpus, sizeof(cpus));
+    printf("Afinidade: %s (CPUs %zu, nos %zu), %s, memoria: ", afinidade_texto, afinidade_num_cpus,
+           afinidade_num_nos, cpus);
+    if (no < 0)
+        printf("primeiro toque\n");
+    else if (afinidade_erro_mbind)
+        printf("no %d (mbind falhou: %s)\n", no, strerror(afinidade_erro_mbind));
+    else
+        printf("no %d\n", no);
+}
+
+#endif
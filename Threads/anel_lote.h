@@ -0,0 +1,97 @@
+/****************************************************************************
+ * Anel do vetor de produção com a contagem de ocupados e os avisos de      *
+ *  lote dos semáforos, compartilhado por 'consumidor_sem.c' e pelas        *
+ *  estratégias sem e futex de 'benchmark_prod_cons.c'.                     *
+ *                                                                          *
+ * O anel guarda somente os índices e a contagem (vazio e cheio têm os      *
+ *  mesmos índices), a cópia dos produtos fica com quem usa (cada programa  *
+ *  tem o seu tipo de produto). Todas as operações rodam dentro da sessão   *
+ *  critica de quem usa, o anel não tem trava própria e pode ficar em       *
+ *  memória compartilhada entre processos (somente valores, sem ponteiros). *
+ *                                                                          *
+ * Avisos de lote: com lote > 1 os semáforos deixam de contar slots e       *
+ *  passam a ser avisos ("existe espaço" e "existe produto"). Cada aviso    *
+ *  existe uma única vez: quem o pega repassa enquanto sobrar espaço (ou    *
+ *  produto), e o outro lado só o recria na transição de cheio para não     *
+ *  cheio (ou de vazio para não vazio). Assim os avisos não se acumulam     *
+ *  quando os lotes dos dois lados têm tamanhos diferentes, e com o vetor   *
+ *  cheio (ou vazio) todos dormem no semáforo. anel_lote_insere() e         *
+ *  anel_lote_remove() informam quais avisos postar após soltar a trava,    *
+ *  quem acorda com um aviso e não encontra espaço (ou produto) o descarta. *
+ *************************************************************************** */
+
+#ifndef ANEL_LOTE_H
+#define ANEL_LOTE_H
+
+#include <stddef.h>
+
+/* Avisos a postar após a sessão critica */
+#define ANEL_REPASSA  1 /* Aviso do próprio lado segue adiante (sobrou espaço ou produto) */
+#define ANEL_CRIA     2 /* Aviso do outro lado (deixou de estar cheio ou vazio) */
+
+typedef struct
+{
+    size_t len_cons; /* Índice de consumo */
+    size_t len_prod; /* Índice de produção */
+    size_t ocupados; /* Produtos no vetor */
+    size_t max;      /* Slots do vetor */
+} anel_lote_t;
+
+
+static inline void anel_lote_inicia(anel_lote_t *a, size_t max)
+{
+    a->len_cons = a->len_prod = a->ocupados = 0;
+    a->max = max;
+}
+
+static inline size_t anel_lote_livres(const anel_lote_t *a)
+{
+    return a->max - a->ocupados;
+}
+
+/* Posição no vetor do i-ésimo produto de um lote iniciado em 'slot' */
+static inline size_t anel_lote_slot(const anel_lote_t *a, size_t slot, size_t i)
+{
+    return (slot + i) % a->max;
+}
+
+/*
+    Reserva até 'n' slots contíguos (com pelo menos um livre), grava o
+    primeiro em 'slot' e os avisos em 'avisos', retorna quantos slots.
+*/
+static inline size_t anel_lote_insere(anel_lote_t *a, size_t n, size_t *slot, int *avisos)
+{
+    size_t livres = anel_lote_livres(a);
+
+    if (n > livres)
+        n = livres;
+    /* Sobrou espaço para outro produtor, vetor deixou de estar vazio */
+    *avisos = (livres > n ? ANEL_REPASSA : 0) | (a->ocupados ? 0 : ANEL_CRIA);
+    *slot = a->len_prod;
+    a->len_prod = (a->len_prod + n) % a->max;
+    a->ocupados += n;
+    return n;
+}
+
+/*
+    Retira até 'max' produtos (com pelo menos um no vetor), grava o primeiro
+    slot em 'slot' e os avisos em 'avisos', retorna quantos produtos. Com a
+    produção encerrada ('fim') o aviso de produto segue adiante mesmo com o
+    vetor vazio, para o próximo consumidor encontrar o fim.
+*/
+static inline size_t anel_lote_remove(anel_lote_t *a, size_t max, int fim, size_t *slot, int *avisos)
+{
+    /* Vetor deixa de estar cheio */
+    *avisos = a->ocupados == a->max ? ANEL_CRIA : 0;
+    if (max > a->ocupados)
+        max = a->ocupados;
+    *slot = a->len_cons;
+    a->len_cons = (a->len_cons + max) % a->max;
+    a->ocupados -= max;
+    /* Sobrou produto (ou a produção encerrou), o aviso segue para outro consumidor */
+    if (a->ocupados || fim)
+        *avisos |= ANEL_REPASSA;
+    return max;
+}
+
+#endif
@@ -0,0 +1,1025 @@
+/****************************************************************************
+ * Benchmark do problema do produtor e consumidor, compara as estratégias   *
+ *  de sincronização de 'consumidor_cond.c' (mutex e variáveis condicionais)*
+ *  e 'consumidor_sem.c' (mutex e semáforos, 'sem_t' ou 'futex_sem.h') com  *
+ *  a mesma carga de trabalho, sem os 'sleep' de simulação e sem printf nas *
+ *  sessões criticas.                                                       *
+ *                                                                          *
+ * Para cada configuração (estratégia x produtores x consumidores x buffer  *
+ *  x taxa) é medido itens por segundo, latência entre envio e consumo de   *
+ *  cada produto (p50, p99 e p999 do histograma de 'latencia.h', um por     *
+ *  consumidor) e trocas de contexto por item, a saída é em CSV ou JSON     *
+ *  para comparação entre execuções. As estratégias sem e futex usam o anel *
+ *  e os avisos de lote de 'anel_lote.h' (os mesmos de 'consumidor_sem.c'), *
+ *  a futex também informa quantas esperas foram atendidas girando e        *
+ *  quantas no kernel. A estratégia fragmentada é a FILA_FRAGMENTADA e a    *
+ *  lockfree a FILA_LOCKFREE de 'consumidor_cond.c' (um fragmento por       *
+ *  consumidor com roubo pela cauda, e a fila MPMC com número de sequência  *
+ *  por slot, a mutex só é usada para dormir com a fila cheia ou vazia).    *
+ *                                                                          *
+ * Taxa '-t' (produtos por segundo somando todos os produtores): carga      *
+ *  aberta, cada produtor segue uma agenda fixa e a latência é medida a     *
+ *  partir do instante pretendido de envio, não da inserção, assim o tempo  *
+ *  travado com o buffer cheio aparece como atraso (sem omissão             *
+ *  coordenada). Taxa 0 (padrão) = carga fechada, latência desde a inserção.*
+ *                                                                          *
+ * Afinidade '-a' (políticas de 'afinidade.h' separadas por '/'): cada      *
+ *  política é mais uma dimensão da comparação, as Threads são criadas na   *
+ *  CPU da política e o vetor de produção é alocado no nó NUMA delas, a     *
+ *  saída informa as CPUs usadas por papel e o nó da memória.               *
+ *                                                                          *
+ * Uso: benchmark_prod_cons [-e cond,sem,futex,fragmentada,lockfree]        *
+ *       [-p 1,2] [-c 1,4] [-b 8,64] [-t 0,100000,1000000]                  *
+ *       [-a nenhuma/compacta/espalhada/produtor=0-3:consumidor=4-7]        *
+ *       [-n produtos por produtor] [-l lote] [-r repetições] [-f csv|json] *
+ *                                                                          *
+ * Obs: o buffer tem 'b' slots úteis em todas as estratégias (o vetor da    *
+ *  estratégia cond recebe um slot extra para distinguir vazio e cheio, a   *
+ *  fragmentada arredonda para um múltiplo do número de consumidores).      *
+ *                                                                          *
+ * ** GCC incluir a biblioteca pthread através do parâmetro '-lpthread'     *
+ * ** Este Programa Finaliza.                                               *
+ *************************************************************************** */
+
+/* sched_getaffinity e pthread_attr_setaffinity_np ('afinidade.h') */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "futex_sem.h"
+#include "afinidade.h"
+#include "latencia.h"
+#include "anel_lote.h"
+
+/* Limite de valores em cada lista da linha de comando */
+#define MAX_LISTA   16
+/* Lote máximo aceito (produtos por sessão critica) */
+#define MAX_LOTE    256
+
+
+/* Produto no vetor, guarda o instante de envio para medir a latência (pretendido na carga aberta) */
+typedef struct
+{
+    size_t valor;
+    uint64_t t_envio;
+} item_t;
+
+/* Latências registradas por cada consumidor (sem compartilhamento) */
+typedef struct
+{
+    size_t id;         /* Índice do consumidor */
+    latencia_t lat;    /* Do envio ao consumo */
+} medidas_t;
+
+/* Operações de uma estratégia de sincronização */
+typedef struct
+{
+    const char *nome;
+    void (*inicia)(void);
+    void (*encerra)(void);
+    size_t (*insere_lote)(const item_t *itens, size_t n);
+    size_t (*remove_lote)(item_t *itens, size_t max);
+    void (*fim_producao)(void);
+} estrategia_t;
+
+
+/* Configuração da rodada atual */
+size_t num_prod, num_cons, tam_buffer, lote, itens_prod;
+size_t taxa;     /* Produtos por segundo de todos os produtores (0 = carga fechada) */
+uint64_t inicio; /* Início da agenda da carga aberta */
+const char *posicionamento; /* Política de afinidade da rodada */
+
+pthread_mutex_t mutex_m, fim_m;      /* Sessão critica acesso ao vetor 'produtos' e índices */
+pthread_cond_t prod_cond, cons_cond; /* Estratégia cond */
+sem_t prod_s, cons_s;                /* Estratégia sem */
+futex_sem_t prod_f, cons_f;          /* Estratégia futex (mesmo algoritmo da sem) */
+int usa_futex;                       /* Estratégia sem usando 'prod_f' e 'cons_f' */
+
+item_t *produtos;    /* Vetor de produção (sessão critica) */
+size_t max_prod;     /* Slots alocados em 'produtos' */
+size_t len_cons;     /* Índice de consumo no vetor 'produtos' (sessão critica) */
+size_t len_prod;     /* Índice de produção no vetor 'produtos' (sessão critica) */
+anel_lote_t anel;    /* Índices e ocupados do vetor (sessão critica, estratégias sem e futex) */
+size_t fim_flag;     /* Flag para encerrar consumidores */
+
+
+/* Relógio monotônico em nanosegundos */
+uint64_t agora_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/* Trocas de contexto (voluntárias e involuntárias) do processo até agora */
+uint64_t trocas_contexto(void)
+{
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    return uso.ru_nvcsw + uso.ru_nivcsw;
+}
+
+/*************************** Estratégia cond ****************************/
+
+void cond_inicia(void)
+{
+    /* Um slot inutilizável para distinguir vazio e cheio */
+    max_prod = tam_buffer + 1;
+    pthread_cond_init(&prod_cond, NULL);
+    pthread_cond_init(&cons_cond, NULL);
+}
+
+void cond_encerra(void)
+{
+    pthread_cond_destroy(&prod_cond);
+    pthread_cond_destroy(&cons_cond);
+}
+
+size_t cond_insere_lote(const item_t *itens, size_t n)
+{
+    size_t i, livres;
+    uint64_t t;
+
+    pthread_mutex_lock(&mutex_m);
+    /* Vetor cheio aguardando por pelo menos um consumidor */
+    while ((len_prod + 1) % max_prod == len_cons)
+        pthread_cond_wait(&prod_cond, &mutex_m);
+
+    livres = (len_cons + max_prod - len_prod - 1) % max_prod;
+    if (n > livres)
+        n = livres;
+    t = agora_ns();
+    for (i = 0; i < n; i++)
+    {
+        produtos[len_prod].valor = itens[i].valor;
+        produtos[len_prod].t_envio = itens[i].t_envio ? itens[i].t_envio : t;
+        len_prod = (len_prod + 1) % max_prod;
+    }
+
+    /* Um único sinal para o lote inteiro */
+    pthread_cond_signal(&cons_cond);
+    if (livres > n)
+        pthread_cond_signal(&prod_cond);
+    pthread_mutex_unlock(&mutex_m);
+    return n;
+}
+
+size_t cond_remove_lote(item_t *itens, size_t max)
+{
+    size_t n = 0;
+
+    pthread_mutex_lock(&mutex_m);
+    /* Vetor vazio aguardando por pelo menos um produtor */
+    while (len_cons == len_prod)
+    {
+        pthread_mutex_lock(&fim_m);
+        if (fim_flag)
+        {
+            pthread_mutex_unlock(&fim_m);
+            pthread_mutex_unlock(&mutex_m);
+            return 0;
+        }
+        pthread_mutex_unlock(&fim_m);
+        pthread_cond_wait(&cons_cond, &mutex_m);
+    }
+
+    while (n < max && len_cons != len_prod)
+    {
+        itens[n++] = produtos[len_cons];
+        len_cons = (len_cons + 1) % max_prod;
+    }
+
+    pthread_cond_signal(&prod_cond);
+    if (len_cons != len_prod)
+        pthread_cond_signal(&cons_cond);
+    pthread_mutex_unlock(&mutex_m);
+    return n;
+}
+
+void cond_fim_producao(void)
+{
+    pthread_mutex_lock(&fim_m);
+    fim_flag = 1;
+    pthread_mutex_unlock(&fim_m);
+
+    /* Livra consumidores travados na falta de produtos */
+    pthread_mutex_lock(&mutex_m);
+    pthread_cond_broadcast(&cons_cond);
+    pthread_mutex_unlock(&mutex_m);
+}
+
+/*************************** Estratégia sem *****************************/
+
+/* Operações no semáforo de produção ou consumo, 'sem_t' ou futex */
+void espera(sem_t *s, futex_sem_t *f)
+{
+    if (usa_futex)
+        futex_sem_wait(f);
+    else
+        sem_wait(s);
+}
+
+void avisa(sem_t *s, futex_sem_t *f)
+{
+    if (usa_futex)
+        futex_sem_post(f);
+    else
+        sem_post(s);
+}
+
+void sem_inicia(void)
+{
+    max_prod = tam_buffer;
+    anel_lote_inicia(&anel, max_prod);
+    /* Com lote > 1 os semáforos são os avisos de lote, a contagem fica em 'ocupados' do anel */
+    sem_init(&prod_s, 0, lote > 1 ? 1 : max_prod);
+    sem_init(&cons_s, 0, 0);
+}
+
+void sem_encerra(void)
+{
+    sem_destroy(&prod_s);
+    sem_destroy(&cons_s);
+}
+
+void futex_inicia(void)
+{
+    max_prod = tam_buffer;
+    anel_lote_inicia(&anel, max_prod);
+    usa_futex = 1;
+    futex_sem_init(&prod_f, 0, lote > 1 ? 1 : max_prod);
+    futex_sem_init(&cons_f, 0, 0);
+}
+
+void futex_encerra(void)
+{
+    futex_sem_destroy(&prod_f);
+    futex_sem_destroy(&cons_f);
+}
+
+size_t sem_insere_lote(const item_t *itens, size_t n)
+{
+    size_t i, slot;
+    int avisos;
+    uint64_t t;
+    item_t *p;
+
+    while (1)
+    {
+        espera(&prod_s, &prod_f);
+        pthread_mutex_lock(&mutex_m);
+        if (anel_lote_livres(&anel))
+            break;
+        /* Aviso excedente (somente com lote > 1), descartado */
+        pthread_mutex_unlock(&mutex_m);
+    }
+
+    n = anel_lote_insere(&anel, n, &slot, &avisos);
+    t = agora_ns();
+    for (i = 0; i < n; i++)
+    {
+        p = &produtos[anel_lote_slot(&anel, slot, i)];
+        p->valor = itens[i].valor;
+        p->t_envio = itens[i].t_envio ? itens[i].t_envio : t;
+    }
+    pthread_mutex_unlock(&mutex_m);
+
+    /* Lote 1: semáforos contam slots e produtos, senão somente os avisos do anel */
+    if (lote == 1)
+        avisa(&cons_s, &cons_f);
+    else
+    {
+        if (avisos & ANEL_REPASSA)
+            avisa(&prod_s, &prod_f);
+        if (avisos & ANEL_CRIA)
+            avisa(&cons_s, &cons_f);
+    }
+    return n;
+}
+
+size_t sem_remove_lote(item_t *itens, size_t max)
+{
+    size_t i, n, slot;
+    int avisos;
+
+    while (1)
+    {
+        espera(&cons_s, &cons_f);
+        pthread_mutex_lock(&mutex_m);
+        if (anel.ocupados)
+            break;
+        if (fim_flag)
+        {
+            pthread_mutex_unlock(&mutex_m);
+            /* Aviso de fim segue para o próximo consumidor */
+            if (lote > 1)
+                avisa(&cons_s, &cons_f);
+            return 0;
+        }
+        /* Aviso excedente (somente com lote > 1), descartado */
+        pthread_mutex_unlock(&mutex_m);
+    }
+
+    n = anel_lote_remove(&anel, max, fim_flag, &slot, &avisos);
+    for (i = 0; i < n; i++)
+        itens[i] = produtos[anel_lote_slot(&anel, slot, i)];
+    pthread_mutex_unlock(&mutex_m);
+
+    if (lote == 1)
+        avisa(&prod_s, &prod_f);
+    else
+    {
+        if (avisos & ANEL_REPASSA)
+            avisa(&cons_s, &cons_f);
+        if (avisos & ANEL_CRIA)
+            avisa(&prod_s, &prod_f);
+    }
+    return n;
+}
+
+void sem_fim_producao(void)
+{
+    size_t i;
+
+    pthread_mutex_lock(&mutex_m);
+    fim_flag = 1;
+    pthread_mutex_unlock(&mutex_m);
+
+    for (i = 0; i < num_cons; i++)
+        avisa(&cons_s, &cons_f);
+}
+
+/*********************** Estratégia fragmentada *************************/
+
+/* Fila local de um consumidor, slots em 'produtos + dono * max_frag' */
+typedef struct
+{
+    _Alignas(64) pthread_mutex_t trava;
+    size_t inicio;          /* Cabeça do anel (sessão critica do fragmento) */
+    atomic_size_t ocupados; /* Escrito sob 'trava', lido sem trava para pular fragmentos */
+} fragmento_t;
+
+fragmento_t *fragmentos;                  /* Um fragmento por consumidor */
+size_t max_frag;                          /* Slots de cada fragmento */
+atomic_size_t prod_esperando, cons_esperando;
+_Thread_local size_t id_thread;           /* Índice da thread (consumidor = dono do fragmento) */
+_Thread_local size_t prox_fragmento;      /* Próximo fragmento a alimentar (por produtor) */
+
+void frag_inicia(void)
+{
+    size_t i;
+    /* Buffer dividido entre os consumidores */
+    max_frag = (tam_buffer + num_cons - 1) / num_cons;
+    max_prod = max_frag * num_cons;
+    fragmentos = aligned_alloc(64, num_cons * sizeof(fragmento_t));
+    for (i = 0; i < num_cons; i++)
+    {
+        pthread_mutex_init(&fragmentos[i].trava, NULL);
+        fragmentos[i].inicio = 0;
+        atomic_init(&fragmentos[i].ocupados, 0);
+    }
+    atomic_init(&prod_esperando, 0);
+    atomic_init(&cons_esperando, 0);
+    pthread_cond_init(&prod_cond, NULL);
+    pthread_cond_init(&cons_cond, NULL);
+}
+
+void frag_encerra(void)
+{
+    size_t i;
+    for (i = 0; i < num_cons; i++)
+        pthread_mutex_destroy(&fragmentos[i].trava);
+    free(fragmentos);
+    pthread_cond_destroy(&prod_cond);
+    pthread_cond_destroy(&cons_cond);
+}
+
+/* Acorda uma thread da condicional somente se existir alguma esperando */
+void acorda_se_esperando(atomic_size_t *esperando, pthread_cond_t *cond)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(esperando, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&mutex_m);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&mutex_m);
+    }
+}
+
+/* Insere no primeiro fragmento com espaço (round-robin), 0 caso todos cheios */
+size_t frag_tenta_insere(const item_t *itens, size_t n)
+{
+    size_t i = 0, k, f, ocupados;
+    fragmento_t *frag;
+    uint64_t t;
+
+    for (k = 0; k < num_cons && i == 0; k++)
+    {
+        f = (prox_fragmento + k) % num_cons;
+        frag = &fragmentos[f];
+        if (atomic_load_explicit(&frag->ocupados, memory_order_relaxed) == max_frag)
+            continue;
+
+        pthread_mutex_lock(&frag->trava);
+        ocupados = atomic_load_explicit(&frag->ocupados, memory_order_relaxed);
+        t = agora_ns();
+        for (; i < n && ocupados < max_frag; i++, ocupados++)
+        {
+            item_t *slot = &produtos[f * max_frag + (frag->inicio + ocupados) % max_frag];
+            slot->valor = itens[i].valor;
+            slot->t_envio = itens[i].t_envio ? itens[i].t_envio : t;
+        }
+        atomic_store_explicit(&frag->ocupados, ocupados, memory_order_relaxed);
+        pthread_mutex_unlock(&frag->trava);
+
+        if (i)
+            prox_fragmento = f + 1;
+    }
+    return i;
+}
+
+/* Remove do próprio fragmento pela cabeça ou rouba dos outros pela cauda, 0 caso todos vazios */
+size_t frag_tenta_remove(item_t *itens, size_t max)
+{
+    size_t n = 0, k, f, ocupados, slot;
+    fragmento_t *frag;
+
+    for (k = 0; k < num_cons && n == 0; k++)
+    {
+        f = (id_thread + k) % num_cons;
+        frag = &fragmentos[f];
+        if (atomic_load_explicit(&frag->ocupados, memory_order_relaxed) == 0)
+            continue;
+
+        pthread_mutex_lock(&frag->trava);
+        ocupados = atomic_load_explicit(&frag->ocupados, memory_order_relaxed);
+        for (; n < max && ocupados; n++, ocupados--)
+        {
+            if (k == 0)
+            {
+                slot = frag->inicio;
+                frag->inicio = (frag->inicio + 1) % max_frag;
+            }
+            else
+                slot = (frag->inicio + ocupados - 1) % max_frag;
+            itens[n] = produtos[f * max_frag + slot];
+        }
+        atomic_store_explicit(&frag->ocupados, ocupados, memory_order_relaxed);
+        pthread_mutex_unlock(&frag->trava);
+    }
+    return n;
+}
+
+size_t frag_insere_lote(const item_t *itens, size_t n)
+{
+    size_t i;
+
+    if ((i = frag_tenta_insere(itens, n)) == 0)
+    {
+        pthread_mutex_lock(&mutex_m);
+        atomic_fetch_add(&prod_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while ((i = frag_tenta_insere(itens, n)) == 0)
+            pthread_cond_wait(&prod_cond, &mutex_m);
+        atomic_fetch_sub(&prod_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
+    acorda_se_esperando(&cons_esperando, &cons_cond);
+    return i;
+}
+
+size_t frag_remove_lote(item_t *itens, size_t max)
+{
+    size_t n;
+
+    if ((n = frag_tenta_remove(itens, max)) == 0)
+    {
+        pthread_mutex_lock(&mutex_m);
+        atomic_fetch_add(&cons_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while ((n = frag_tenta_remove(itens, max)) == 0)
+        {
+            pthread_mutex_lock(&fim_m);
+            if (fim_flag)
+            {
+                pthread_mutex_unlock(&fim_m);
+                atomic_fetch_sub(&cons_esperando, 1);
+                pthread_mutex_unlock(&mutex_m);
+                return 0;
+            }
+            pthread_mutex_unlock(&fim_m);
+            pthread_cond_wait(&cons_cond, &mutex_m);
+        }
+        atomic_fetch_sub(&cons_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
+    acorda_se_esperando(&prod_esperando, &prod_cond);
+    return n;
+}
+
+/************************* Estratégia lockfree **************************/
+
+/* Slot da fila, 'seq' informa se o slot está livre para produção ou pronto para consumo */
+typedef struct
+{
+    atomic_size_t seq;
+    item_t item;
+} slot_t;
+
+/* Índice isolado em sua própria linha de cache (evita falso compartilhamento) */
+typedef struct
+{
+    _Alignas(64) atomic_size_t v;
+} indice_t;
+
+slot_t *slots;         /* Fila de 'max_slots' posições (acesso atômico por slot, no lugar de 'produtos') */
+size_t max_slots;
+indice_t pos_cons;     /* Posição absoluta de consumo (cresce sem voltar, slot = pos % max_slots) */
+indice_t pos_prod;     /* Posição absoluta de produção (cresce sem voltar, slot = pos % max_slots) */
+
+void lf_inicia(void)
+{
+    size_t i;
+    /* Os slots levam os itens, sem o vetor 'produtos' */
+    max_prod = 0;
+    max_slots = tam_buffer;
+    if (!(slots = afinidade_aloca(max_slots * sizeof(slot_t))))
+    {
+        fprintf(stderr, "Sem memoria para %zu slots\n", max_slots);
+        exit(1);
+    }
+    for (i = 0; i < max_slots; i++)
+        atomic_init(&slots[i].seq, i);
+    atomic_init(&pos_cons.v, 0);
+    atomic_init(&pos_prod.v, 0);
+    atomic_init(&prod_esperando, 0);
+    atomic_init(&cons_esperando, 0);
+    pthread_cond_init(&prod_cond, NULL);
+    pthread_cond_init(&cons_cond, NULL);
+}
+
+void lf_encerra(void)
+{
+    free(slots);
+    pthread_cond_destroy(&prod_cond);
+    pthread_cond_destroy(&cons_cond);
+}
+
+/* Tenta inserir um item, 0 caso a fila esteja cheia. O slot está livre para a posição 'pos' quando 'seq == pos' */
+int lf_tenta_insere(const item_t *item, uint64_t t)
+{
+    size_t pos = atomic_load_explicit(&pos_prod.v, memory_order_relaxed), seq;
+    slot_t *slot;
+    intptr_t dif;
+
+    while (1)
+    {
+        slot = &slots[pos % max_slots];
+        seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0)
+        {
+            /* Slot livre, tenta reservar a posição avançando o índice de produção */
+            if (atomic_compare_exchange_weak_explicit(&pos_prod.v, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                slot->item.valor = item->valor;
+                slot->item.t_envio = item->t_envio ? item->t_envio : t;
+                /* Publica o item para os consumidores */
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+        }
+        else if (dif < 0)
+            /* Slot ainda não consumido da volta anterior, fila cheia */
+            return 0;
+        else
+            /* Outro produtor pegou a posição, recarrega */
+            pos = atomic_load_explicit(&pos_prod.v, memory_order_relaxed);
+    }
+}
+
+/* Tenta remover um item, 0 caso a fila esteja vazia. O slot está pronto na posição 'pos' quando 'seq == pos + 1' */
+int lf_tenta_remove(item_t *item)
+{
+    size_t pos = atomic_load_explicit(&pos_cons.v, memory_order_relaxed), seq;
+    slot_t *slot;
+    intptr_t dif;
+
+    while (1)
+    {
+        slot = &slots[pos % max_slots];
+        seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0)
+        {
+            /* Item publicado, tenta reservar a posição avançando o índice de consumo */
+            if (atomic_compare_exchange_weak_explicit(&pos_cons.v, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                *item = slot->item;
+                /* Libera o slot para a próxima volta dos produtores */
+                atomic_store_explicit(&slot->seq, pos + max_slots, memory_order_release);
+                return 1;
+            }
+        }
+        else if (dif < 0)
+            /* Slot ainda não produzido, fila vazia */
+            return 0;
+        else
+            /* Outro consumidor pegou a posição, recarrega */
+            pos = atomic_load_explicit(&pos_cons.v, memory_order_relaxed);
+    }
+}
+
+size_t lf_insere_lote(const item_t *itens, size_t n)
+{
+    size_t i;
+    uint64_t t = agora_ns();
+
+    /* Caminho rápido sem trava, a mutex só é usada com a fila cheia */
+    if (!lf_tenta_insere(&itens[0], t))
+    {
+        pthread_mutex_lock(&mutex_m);
+        atomic_fetch_add(&prod_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (!lf_tenta_insere(&itens[0], t = agora_ns()))
+            pthread_cond_wait(&prod_cond, &mutex_m);
+        atomic_fetch_sub(&prod_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
+    /* Restante do lote somente enquanto houver espaço (sem bloquear) */
+    for (i = 1; i < n && lf_tenta_insere(&itens[i], t); i++)
+        ;
+    acorda_se_esperando(&cons_esperando, &cons_cond);
+    return i;
+}
+
+size_t lf_remove_lote(item_t *itens, size_t max)
+{
+    size_t n;
+
+    /* Caminho rápido sem trava, a mutex só é usada com a fila vazia */
+    if (!lf_tenta_remove(&itens[0]))
+    {
+        pthread_mutex_lock(&mutex_m);
+        atomic_fetch_add(&cons_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (!lf_tenta_remove(&itens[0]))
+        {
+            /* Fila vazia e produção encerrada, fim (a fila é drenada antes) */
+            pthread_mutex_lock(&fim_m);
+            if (fim_flag)
+            {
+                pthread_mutex_unlock(&fim_m);
+                atomic_fetch_sub(&cons_esperando, 1);
+                pthread_mutex_unlock(&mutex_m);
+                return 0;
+            }
+            pthread_mutex_unlock(&fim_m);
+            pthread_cond_wait(&cons_cond, &mutex_m);
+        }
+        atomic_fetch_sub(&cons_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
+    /* Restante do lote somente enquanto houver item (sem bloquear) */
+    for (n = 1; n < max && lf_tenta_remove(&itens[n]); n++)
+        ;
+    acorda_se_esperando(&prod_esperando, &prod_cond);
+    /* Lote cheio, pode ter sobrado item para outro consumidor dormindo */
+    if (max > 1 && n == max)
+        acorda_se_esperando(&cons_esperando, &cons_cond);
+    return n;
+}
+
+estrategia_t estrategias[] = {
+    {"cond", cond_inicia, cond_encerra, cond_insere_lote, cond_remove_lote, cond_fim_producao},
+    {"sem", sem_inicia, sem_encerra, sem_insere_lote, sem_remove_lote, sem_fim_producao},
+    {"futex", futex_inicia, futex_encerra, sem_insere_lote, sem_remove_lote, sem_fim_producao},
+    {"fragmentada", frag_inicia, frag_encerra, frag_insere_lote, frag_remove_lote, cond_fim_producao},
+    {"lockfree", lf_inicia, lf_encerra, lf_insere_lote, lf_remove_lote, cond_fim_producao},
+};
+#define NUM_ESTRATEGIAS (sizeof(estrategias) / sizeof(estrategias[0]))
+
+estrategia_t *atual; /* Estratégia da rodada */
+
+/****************************** Threads *********************************/
+
+void *produtor(void *num_thread)
+{
+    item_t itens[MAX_LOTE];
+    size_t prod_cont = 0, i, n, lim;
+    uint64_t periodo = 0, proximo = 0, agora;
+
+    /* Afinidade inicial, cada produtor começa por um fragmento diferente */
+    id_thread = (size_t)(uintptr_t)num_thread;
+    prox_fragmento = id_thread % num_cons;
+
+    if (taxa)
+    {
+        /* Agenda da carga aberta, produtores defasados para espalhar os envios */
+        periodo = (uint64_t)(1e9 * num_prod / taxa);
+        proximo = inicio + periodo * id_thread / num_prod;
+    }
+
+    while (prod_cont < itens_prod)
+    {
+        lim = itens_prod - prod_cont;
+        if (lim > lote)
+            lim = lote;
+        if (periodo)
+        {
+            /* Aguarda o instante pretendido, atrasado envia na hora e junta os vencidos no lote */
+            agora = agora_ns();
+            if (agora < proximo)
+            {
+                struct timespec t = {proximo / 1000000000ull, proximo % 1000000000ull};
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL))
+                    ;
+                agora = proximo;
+            }
+            for (n = 0; n < lim && proximo + n * periodo <= agora; n++)
+                itens[n].t_envio = proximo + n * periodo;
+        }
+        else
+        {
+            /* Carga fechada, instante de envio é o da inserção */
+            for (n = 0; n < lim; n++)
+                itens[n].t_envio = 0;
+        }
+        for (i = 0; i < n; i++)
+            itens[i].valor = prod_cont + i + 1;
+        i = atual->insere_lote(itens, n);
+        /* Somente o inserido avança a agenda, o resto mantém o instante pretendido */
+        proximo += i * periodo;
+        prod_cont += i;
+    }
+    return NULL;
+}
+
+void *consumidor(void *medidas)
+{
+    medidas_t *m = (medidas_t *)medidas;
+    item_t itens[MAX_LOTE];
+    size_t i, n;
+    uint64_t t;
+
+    id_thread = m->id;
+    while ((n = atual->remove_lote(itens, lote)) != 0)
+    {
+        t = agora_ns();
+        for (i = 0; i < n; i++)
+            latencia_registra(&m->lat, t - itens[i].t_envio);
+    }
+    return NULL;
+}
+
+/****************************** Rodada **********************************/
+
+/* Executa uma configuração e imprime uma linha (CSV) ou objeto (JSON) */
+void rodada(int json, int primeira)
+{
+    size_t i, n_lat;
+    pthread_attr_t atributos;
+    pthread_t *prodT = malloc(num_prod * sizeof(pthread_t));
+    pthread_t *consT = malloc(num_cons * sizeof(pthread_t));
+    medidas_t *medidas = malloc(num_cons * sizeof(medidas_t));
+    latencia_t lat;
+    uint64_t t0, t1, cs0, cs1, giro = 0, kernel = 0;
+    double segundos;
+    char cpus[256];
+
+    if (!prodT || !consT || !medidas)
+    {
+        fprintf(stderr, "Sem memoria para %zu produtores e %zu consumidores\n", num_prod, num_cons);
+        exit(1);
+    }
+
+    /* Posiciona as Threads da rodada (antes da estratégia, que pode alocar no nó delas) */
+    afinidade_configura(posicionamento);
+    afinidade_papel(AFINIDADE_CONSUMIDOR, num_cons);
+    afinidade_papel(AFINIDADE_PRODUTOR, num_prod);
+    afinidade_descreve(cpus, sizeof(cpus));
+
+    max_prod = 0;
+    usa_futex = 0;
+    len_cons = len_prod = fim_flag = 0;
+    atual->inicia();
+
+    /* Vetor de produção no nó das Threads (a estratégia lockfree usa os próprios slots) */
+    produtos = NULL;
+    if (max_prod && !(produtos = afinidade_aloca(max_prod * sizeof(item_t))))
+    {
+        fprintf(stderr, "Sem memoria para %zu produtos\n", max_prod);
+        exit(1);
+    }
+
+    /* Histograma de latência por consumidor, tamanho fixo (independe da produção) */
+    latencia_zera(&lat);
+    for (i = 0; i < num_cons; i++)
+    {
+        medidas[i].id = i;
+        latencia_zera(&medidas[i].lat);
+    }
+
+    cs0 = trocas_contexto();
+    t0 = agora_ns();
+    /* Primeiro envio da agenda logo após criar as threads */
+    inicio = t0 + 1000000;
+    for (i = 0; i < num_cons; i++)
+    {
+        pthread_create(consT + i, afinidade_attr(&atributos, AFINIDADE_CONSUMIDOR, i), consumidor, medidas + i);
+        pthread_attr_destroy(&atributos);
+    }
+    for (i = 0; i < num_prod; i++)
+    {
+        pthread_create(prodT + i, afinidade_attr(&atributos, AFINIDADE_PRODUTOR, i), produtor, (void *)(uintptr_t)i);
+        pthread_attr_destroy(&atributos);
+    }
+
+    for (i = 0; i < num_prod; i++)
+        pthread_join(prodT[i], NULL);
+    atual->fim_producao();
+    for (i = 0; i < num_cons; i++)
+        pthread_join(consT[i], NULL);
+    t1 = agora_ns();
+    cs1 = trocas_contexto();
+
+    /* Junta as latências de todos os consumidores */
+    for (i = 0; i < num_cons; i++)
+        latencia_junta(&lat, &medidas[i].lat);
+    n_lat = lat.n;
+    segundos = (double)(t1 - t0) / 1e9;
+
+    /* Esperas resolvidas girando e no kernel (somente estratégia futex) */
+    if (usa_futex)
+    {
+        giro = atomic_load(&prod_f.esperas_giro) + atomic_load(&cons_f.esperas_giro);
+        kernel = atomic_load(&prod_f.esperas_kernel) + atomic_load(&cons_f.esperas_kernel);
+    }
+
+    if (json)
+        printf("%s  {\"estrategia\": \"%s\", \"produtores\": %zu, \"consumidores\": %zu, "
+               "\"buffer\": %zu, \"lote\": %zu, \"taxa\": %zu, \"itens\": %zu, \"segundos\": %.6f, "
+               "\"itens_por_s\": %.1f, \"lat_p50_ns\": %llu, \"lat_p99_ns\": %llu, "
+               "\"lat_p999_ns\": %llu, \"trocas_contexto_por_item\": %.4f, "
+               "\"esperas_giro\": %llu, \"esperas_kernel\": %llu, "
+               "\"afinidade\": \"%s\", \"cpus\": \"%s\", \"no_memoria\": %d}",
+               primeira ? "" : ",\n", atual->nome, num_prod, num_cons, tam_buffer, lote, taxa, n_lat,
+               segundos, n_lat / segundos,
+               (unsigned long long)latencia_percentil(&lat, 0.50),
+               (unsigned long long)latencia_percentil(&lat, 0.99),
+               (unsigned long long)latencia_percentil(&lat, 0.999),
+               (double)(cs1 - cs0) / n_lat,
+               (unsigned long long)giro, (unsigned long long)kernel,
+               posicionamento, cpus, afinidade_no());
+    else
+        printf("%s,%zu,%zu,%zu,%zu,%zu,%zu,%.6f,%.1f,%llu,%llu,%llu,%.4f,%llu,%llu,\"%s\",\"%s\",%d\n",
+               atual->nome, num_prod, num_cons, tam_buffer, lote, taxa, n_lat,
+               segundos, n_lat / segundos,
+               (unsigned long long)latencia_percentil(&lat, 0.50),
+               (unsigned long long)latencia_percentil(&lat, 0.99),
+               (unsigned long long)latencia_percentil(&lat, 0.999),
+               (double)(cs1 - cs0) / n_lat,
+               (unsigned long long)giro, (unsigned long long)kernel,
+               posicionamento, cpus, afinidade_no());
+    fflush(stdout);
+
+    atual->encerra();
+    free(produtos);
+    free(medidas);
+    free(prodT);
+    free(consT);
+}
+
+/* Lê uma lista "1,2,4" em 'v', retorna quantos valores foram lidos ('zero' aceita 0) */
+size_t le_lista(const char *txt, size_t *v, int zero)
+{
+    size_t n = 0;
+    char *fim;
+    while (*txt && n < MAX_LISTA)
+    {
+        v[n] = strtoul(txt, &fim, 10);
+        if (fim == txt || (v[n] == 0 && !zero))
+            break;
+        n++;
+        txt = *fim == ',' ? fim + 1 : fim;
+    }
+    return n;
+}
+
+void uso(const char *prog)
+{
+    fprintf(stderr, "Uso: %s [-e cond,sem,futex,fragmentada,lockfree] [-p 1,2,4] [-c 1,4,12] [-b 8,64] [-t 0,100000] "
+                    "[-a nenhuma/compacta/espalhada] [-n produtos por produtor] [-l lote] [-r repeticoes] "
+                    "[-f csv|json]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t p_lista[MAX_LISTA] = {4}, c_lista[MAX_LISTA] = {12}, b_lista[MAX_LISTA] = {21};
+    size_t t_lista[MAX_LISTA] = {0};
+    const char *a_lista[MAX_LISTA] = {"nenhuma"};
+    size_t n_p = 1, n_c = 1, n_b = 1, n_t = 1, n_a = 1, repeticoes = 1;
+    size_t e, ip, ic, ib, it, ia, r;
+    int usa_estrategia[NUM_ESTRATEGIAS], json = 0, primeira = 1, opt;
+    char *txt;
+
+    for (e = 0; e < NUM_ESTRATEGIAS; e++)
+        usa_estrategia[e] = 1;
+    lote = 1;
+    itens_prod = 100000;
+
+    while ((opt = getopt(argc, argv, "e:p:c:b:t:a:n:l:r:f:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'e':
+            for (e = 0; e < NUM_ESTRATEGIAS; e++)
+                usa_estrategia[e] = 0;
+            for (txt = strtok(optarg, ","); txt; txt = strtok(NULL, ","))
+            {
+                for (e = 0; e < NUM_ESTRATEGIAS && strcmp(txt, estrategias[e].nome); e++)
+                    ;
+                /* Nome desconhecido */
+                if (e == NUM_ESTRATEGIAS)
+                    uso(argv[0]);
+                usa_estrategia[e] = 1;
+            }
+            /* Nenhuma estratégia ('-e ,') */
+            for (e = 0; e < NUM_ESTRATEGIAS && !usa_estrategia[e]; e++)
+                ;
+            if (e == NUM_ESTRATEGIAS)
+                uso(argv[0]);
+            break;
+        case 'p': n_p = le_lista(optarg, p_lista, 0); break;
+        case 'c': n_c = le_lista(optarg, c_lista, 0); break;
+        case 'b': n_b = le_lista(optarg, b_lista, 0); break;
+        case 't': n_t = le_lista(optarg, t_lista, 1); break;
+        case 'a':
+            for (n_a = 0, txt = strtok(optarg, "/"); txt && n_a < MAX_LISTA; txt = strtok(NULL, "/"))
+            {
+                if (afinidade_configura(txt))
+                    uso(argv[0]);
+                a_lista[n_a++] = txt;
+            }
+            break;
+        case 'n': itens_prod = strtoul(optarg, NULL, 10); break;
+        case 'l': lote = strtoul(optarg, NULL, 10); break;
+        case 'r': repeticoes = strtoul(optarg, NULL, 10); break;
+        case 'f': json = !strcmp(optarg, "json"); break;
+        default: uso(argv[0]);
+        }
+    }
+    if (!n_p || !n_c || !n_b || !n_t || !n_a || !itens_prod || !repeticoes || lote < 1 || lote > MAX_LOTE)
+        uso(argv[0]);
+
+    pthread_mutex_init(&mutex_m, NULL);
+    pthread_mutex_init(&fim_m, NULL);
+
+    if (json)
+        printf("[\n");
+    else
+        printf("estrategia,produtores,consumidores,buffer,lote,taxa,itens,segundos,itens_por_s,"
+               "lat_p50_ns,lat_p99_ns,lat_p999_ns,trocas_contexto_por_item,"
+               "esperas_giro,esperas_kernel,afinidade,cpus,no_memoria\n");
+
+    for (e = 0; e < NUM_ESTRATEGIAS; e++)
+    {
+        if (!usa_estrategia[e])
+            continue;
+        atual = &estrategias[e];
+        for (ip = 0; ip < n_p; ip++)
+            for (ic = 0; ic < n_c; ic++)
+                for (ib = 0; ib < n_b; ib++)
+                    for (it = 0; it < n_t; it++)
+                        for (ia = 0; ia < n_a; ia++)
+                            for (r = 0; r < repeticoes; r++)
+                            {
+                                num_prod = p_lista[ip];
+                                num_cons = c_lista[ic];
+                                tam_buffer = b_lista[ib];
+                                taxa = t_lista[it];
+                                posicionamento = a_lista[ia];
+                                rodada(json, primeira);
+                                primeira = 0;
+                            }
+    }
+
+    if (json)
+        printf("\n]\n");
+
+    pthread_mutex_destroy(&mutex_m);
+    pthread_mutex_destroy(&fim_m);
+
+    return 0;
+}
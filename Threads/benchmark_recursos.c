@@ -0,0 +1,315 @@
+/****************************************************************************
+ * Benchmark do gerenciador de recursos de 'recursos.h': cada Thread faz    *
+ *  pedidos de 'k' recursos sorteados entre 'm', segura todos por um tempo  *
+ *  ocupando a CPU (sessão critica) e devolve.                              *
+ *                                                                          *
+ * Sobreposição '-o' (porcentagem): cada Thread tem uma fatia própria dos   *
+ *  'm' recursos, cada índice do pedido sai de qualquer lugar com essa      *
+ *  probabilidade e da fatia própria no restante. 0 = Threads sem recursos  *
+ *  em comum, 100 = sorteio uniforme entre todos.                           *
+ *                                                                          *
+ * Para cada configuração (estratégia x Threads x k x m x sobreposição) é   *
+ *  medido pedidos por segundo, espera até ter o conjunto (p50, p99 e       *
+ *  p999), esperas na fila por pedido e trocas de contexto por pedido, em   *
+ *  CSV ou JSON. A estratégia global (uma mutex para todos os recursos) é   *
+ *  a referência.                                                           *
+ *                                                                          *
+ * Uso: benchmark_recursos [-e gerenciador,global] [-t 2,8] [-k 1,2,4,8]    *
+ *       [-m 64,4096] [-o 0,10,100] [-s ns na sessão] [-n pedidos por       *
+ *       Thread] [-r repetições] [-f csv|json]                              *
+ *                                                                          *
+ * ** GCC incluir a biblioteca pthread através do parâmetro '-lpthread'     *
+ * ** Este Programa Finaliza.                                               *
+ *************************************************************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "carga.h"
+#include "latencia.h"
+#include "recursos.h"
+
+/* Limite de valores em cada lista da linha de comando */
+#define MAX_LISTA     16
+/* Maior conjunto aceito em um pedido */
+#define MAX_CONJUNTO  64
+
+
+/* Medidas de cada Thread (sem compartilhamento) */
+typedef struct
+{
+    size_t id;
+    latencia_t espera; /* Do pedido até ter todos os recursos */
+} medidas_t;
+
+
+/* Configuração da rodada atual */
+size_t num_threads, tam_conjunto, num_recursos, sobreposicao, pedidos;
+uint64_t sessao_ns = 1000; /* Tempo com os recursos (ocupando a CPU) */
+int usa_global;            /* Estratégia global da rodada */
+
+recursos_t gerenciador;    /* Estratégia gerenciador */
+pthread_mutex_t mutex_m;   /* Estratégia global, uma trava para todos os recursos */
+unsigned long esperas_global; /* Aquisições da mutex_m que encontraram a trava ocupada */
+
+
+/* Trocas de contexto (voluntárias e involuntárias) do processo até agora */
+uint64_t trocas_contexto(void)
+{
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    return uso.ru_nvcsw + uso.ru_nivcsw;
+}
+
+/* Segura os recursos ocupando a CPU (sem dormir com eles) */
+void sessao(uint64_t ns)
+{
+    uint64_t prazo = carga_agora_ns() + ns;
+    while (carga_agora_ns() < prazo)
+        ;
+}
+
+/****************************** Threads *********************************/
+
+void *cliente(void *arg)
+{
+    medidas_t *m = (medidas_t *)arg;
+    size_t ids[MAX_CONJUNTO], fatia, base, i, j, n;
+    uint64_t t0;
+    carga_t carga;
+
+    /* Fatia própria da Thread (pelo menos um recurso) */
+    fatia = num_recursos / num_threads ? num_recursos / num_threads : 1;
+    base = (m->id * fatia) % num_recursos;
+    carga_inicia(&carga, m->id);
+
+    for (i = 0; i < pedidos; i++)
+    {
+        for (j = 0; j < tam_conjunto; j++)
+        {
+            if (carga_intervalo(&carga, 100) < sobreposicao)
+                ids[j] = carga_intervalo(&carga, num_recursos);
+            else
+                ids[j] = (base + carga_intervalo(&carga, fatia)) % num_recursos;
+        }
+
+        t0 = carga_agora_ns();
+        if (usa_global)
+        {
+            if (pthread_mutex_trylock(&mutex_m))
+            {
+                pthread_mutex_lock(&mutex_m);
+                esperas_global++;
+            }
+            latencia_registra(&m->espera, carga_agora_ns() - t0);
+            sessao(sessao_ns);
+            pthread_mutex_unlock(&mutex_m);
+        }
+        else
+        {
+            n = recursos_pega(&gerenciador, ids, tam_conjunto);
+            latencia_registra(&m->espera, carga_agora_ns() - t0);
+            sessao(sessao_ns);
+            recursos_devolve(&gerenciador, ids, n);
+        }
+    }
+    return NULL;
+}
+
+/****************************** Rodada **********************************/
+
+/* Executa uma configuração e imprime uma linha (CSV) ou objeto (JSON) */
+void rodada(int json, int primeira)
+{
+    size_t i, total = num_threads * pedidos;
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    medidas_t *medidas = malloc(num_threads * sizeof(medidas_t));
+    latencia_t espera;
+    unsigned long aquisicoes, esperas;
+    uint64_t t0, t1, cs0, cs1;
+    double segundos;
+
+    if (!threads || !medidas)
+    {
+        fprintf(stderr, "Sem memoria para %zu threads\n", num_threads);
+        exit(1);
+    }
+    if (usa_global)
+        esperas_global = 0;
+    else if (recursos_inicia(&gerenciador, num_recursos) < 0)
+    {
+        fprintf(stderr, "Sem memoria para %zu recursos\n", num_recursos);
+        exit(1);
+    }
+    latencia_zera(&espera);
+    for (i = 0; i < num_threads; i++)
+    {
+        medidas[i].id = i;
+        latencia_zera(&medidas[i].espera);
+    }
+
+    cs0 = trocas_contexto();
+    t0 = carga_agora_ns();
+    for (i = 0; i < num_threads; i++)
+        pthread_create(threads + i, NULL, cliente, medidas + i);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    t1 = carga_agora_ns();
+    cs1 = trocas_contexto();
+
+    for (i = 0; i < num_threads; i++)
+        latencia_junta(&espera, &medidas[i].espera);
+    segundos = (double)(t1 - t0) / 1e9;
+    if (usa_global)
+        esperas = esperas_global;
+    else
+    {
+        recursos_totais(&gerenciador, &aquisicoes, &esperas);
+        recursos_destroi(&gerenciador);
+    }
+
+    if (json)
+        printf("%s  {\"estrategia\": \"%s\", \"threads\": %zu, \"conjunto\": %zu, \"recursos\": %zu, "
+               "\"sobreposicao\": %zu, \"sessao_ns\": %llu, \"pedidos\": %zu, \"segundos\": %.6f, "
+               "\"pedidos_por_s\": %.1f, \"espera_p50_ns\": %llu, \"espera_p99_ns\": %llu, "
+               "\"espera_p999_ns\": %llu, \"esperas_por_pedido\": %.4f, "
+               "\"trocas_contexto_por_pedido\": %.4f}",
+               primeira ? "" : ",\n", usa_global ? "global" : "gerenciador", num_threads,
+               tam_conjunto, num_recursos, sobreposicao, (unsigned long long)sessao_ns, total,
+               segundos, total / segundos,
+               (unsigned long long)latencia_percentil(&espera, 0.50),
+               (unsigned long long)latencia_percentil(&espera, 0.99),
+               (unsigned long long)latencia_percentil(&espera, 0.999),
+               (double)esperas / total, (double)(cs1 - cs0) / total);
+    else
+        printf("%s,%zu,%zu,%zu,%zu,%llu,%zu,%.6f,%.1f,%llu,%llu,%llu,%.4f,%.4f\n",
+               usa_global ? "global" : "gerenciador", num_threads, tam_conjunto, num_recursos,
+               sobreposicao, (unsigned long long)sessao_ns, total, segundos, total / segundos,
+               (unsigned long long)latencia_percentil(&espera, 0.50),
+               (unsigned long long)latencia_percentil(&espera, 0.99),
+               (unsigned long long)latencia_percentil(&espera, 0.999),
+               (double)esperas / total, (double)(cs1 - cs0) / total);
+    fflush(stdout);
+
+    free(medidas);
+    free(threads);
+}
+
+/* Lê uma lista "1,2,4" em 'v', retorna quantos valores foram lidos ('zero' aceita 0) */
+size_t le_lista(const char *txt, size_t *v, int zero)
+{
+    size_t n = 0;
+    char *fim;
+    while (*txt && n < MAX_LISTA)
+    {
+        v[n] = strtoul(txt, &fim, 10);
+        if (fim == txt || (v[n] == 0 && !zero))
+            break;
+        n++;
+        txt = *fim == ',' ? fim + 1 : fim;
+    }
+    return n;
+}
+
+void uso(const char *prog)
+{
+    fprintf(stderr, "Uso: %s [-e gerenciador,global] [-t 2,8] [-k 1,2,4,8] [-m 64,4096] [-o 0,10,100] "
+                    "[-s ns na sessao] [-n pedidos por Thread] [-r repeticoes] [-f csv|json]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t t_lista[MAX_LISTA] = {4}, k_lista[MAX_LISTA] = {2}, m_lista[MAX_LISTA] = {64};
+    size_t o_lista[MAX_LISTA] = {100};
+    size_t n_t = 1, n_k = 1, n_m = 1, n_o = 1, repeticoes = 1;
+    size_t e, it, ik, im, io, r;
+    int usa_estrategia[2] = {1, 1}, json = 0, primeira = 1, opt;
+    const char *nomes[2] = {"gerenciador", "global"};
+    char *txt;
+
+    pedidos = 100000;
+
+    while ((opt = getopt(argc, argv, "e:t:k:m:o:s:n:r:f:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'e':
+            usa_estrategia[0] = usa_estrategia[1] = 0;
+            for (txt = strtok(optarg, ","); txt; txt = strtok(NULL, ","))
+            {
+                for (e = 0; e < 2 && strcmp(txt, nomes[e]); e++)
+                    ;
+                /* Nome desconhecido */
+                if (e == 2)
+                    uso(argv[0]);
+                usa_estrategia[e] = 1;
+            }
+            /* Nenhuma estratégia ('-e ,') */
+            if (!usa_estrategia[0] && !usa_estrategia[1])
+                uso(argv[0]);
+            break;
+        case 't': n_t = le_lista(optarg, t_lista, 0); break;
+        case 'k': n_k = le_lista(optarg, k_lista, 0); break;
+        case 'm': n_m = le_lista(optarg, m_lista, 0); break;
+        case 'o': n_o = le_lista(optarg, o_lista, 1); break;
+        case 's': sessao_ns = strtoull(optarg, NULL, 10); break;
+        case 'n': pedidos = strtoul(optarg, NULL, 10); break;
+        case 'r': repeticoes = strtoul(optarg, NULL, 10); break;
+        case 'f': json = !strcmp(optarg, "json"); break;
+        default: uso(argv[0]);
+        }
+    }
+    if (!n_t || !n_k || !n_m || !n_o || !pedidos || !repeticoes)
+        uso(argv[0]);
+    for (ik = 0; ik < n_k; ik++)
+        if (k_lista[ik] > MAX_CONJUNTO)
+            uso(argv[0]);
+    for (io = 0; io < n_o; io++)
+        if (o_lista[io] > 100)
+            uso(argv[0]);
+
+    /* Semente da carga (variável CARGA_SEMENTE), mesma semente = mesmos pedidos */
+    carga_configura();
+    pthread_mutex_init(&mutex_m, NULL);
+
+    if (json)
+        printf("[\n");
+    else
+        printf("estrategia,threads,conjunto,recursos,sobreposicao,sessao_ns,pedidos,segundos,"
+               "pedidos_por_s,espera_p50_ns,espera_p99_ns,espera_p999_ns,esperas_por_pedido,"
+               "trocas_contexto_por_pedido\n");
+
+    for (e = 0; e < 2; e++)
+    {
+        if (!usa_estrategia[e])
+            continue;
+        usa_global = e == 1;
+        for (it = 0; it < n_t; it++)
+            for (ik = 0; ik < n_k; ik++)
+                for (im = 0; im < n_m; im++)
+                    for (io = 0; io < n_o; io++)
+                        for (r = 0; r < repeticoes; r++)
+                        {
+                            num_threads = t_lista[it];
+                            tam_conjunto = k_lista[ik];
+                            num_recursos = m_lista[im];
+                            sobreposicao = o_lista[io];
+                            rodada(json, primeira);
+                            primeira = 0;
+                        }
+    }
+
+    if (json)
+        printf("\n]\n");
+
+    pthread_mutex_destroy(&mutex_m);
+
+    return 0;
+}
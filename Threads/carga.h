@@ -0,0 +1,278 @@
+/****************************************************************************
+ * Gerador de carga reproduzível por thread, substitui o srand/rand (estado *
+ *  global escondido, sem segurança entre threads) e o 'sleep' de pacing    *
+ *  dos programas de Threads.                                               *
+ *                                                                          *
+ * Cada thread possui seu próprio 'carga_t' (xoshiro256**) inicializado a   *
+ *  partir de uma semente explícita e do número da thread, assim a mesma    *
+ *  semente reproduz exatamente a sequência de valores e tempos de serviço. *
+ *                                                                          *
+ * Tempos de serviço com média configurável e distribuição:                 *
+ *  uniforme (0.5 a 1.5 da média, padrão), constante, exponencial ou        *
+ *  pareto (cauda pesada, forma CARGA_PARETO_ALFA), cumpridos dormindo com  *
+ *  clock_nanosleep (resolução de nanosegundos) ou ocupando a CPU.          *
+ *                                                                          *
+ * Configuração em compilação (-DCARGA_SEMENTE=N, -DCARGA_DISTRIBUICAO=...) *
+ *  ou em execução por variáveis de ambiente lidas em carga_configura():    *
+ *  CARGA_SEMENTE=N, CARGA_DIST=uniforme|constante|exponencial|pareto,      *
+ *  CARGA_ESPERA=dormir|ocupar, CARGA_ESCALA=fator das médias (ex. 0.01).   *
+ *                                                                          *
+ * Carga aberta (CARGA_TAXA=N, produtos por segundo de cada produtor): os   *
+ *  produtores seguem uma agenda fixa (um produto a cada 1/N segundos)      *
+ *  independente da fila, assim um produtor travado acumula atraso em vez   *
+ *  de reduzir a carga. A latência deve ser medida a partir do instante     *
+ *  pretendido na agenda (sem omissão coordenada). Padrão 0 = carga         *
+ *  fechada (o produtor só produz após conseguir inserir o anterior).       *
+ *                                                                          *
+ * ** Não depende da libm (ln e exp implementados aqui).                    *
+ *************************************************************************** */
+
+#ifndef CARGA_H
+#define CARGA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef __linux__
+#error "OS Not Supported"
+#endif
+
+/* Distribuições dos tempos de serviço */
+#define CARGA_UNIFORME     0
+#define CARGA_CONSTANTE    1
+#define CARGA_EXPONENCIAL  2
+#define CARGA_PARETO       3
+
+/* Semente padrão (mesma semente = mesma carga) */
+#ifndef CARGA_SEMENTE
+#define CARGA_SEMENTE       20240101ull
+#endif
+/* Distribuição padrão dos tempos de serviço */
+#ifndef CARGA_DISTRIBUICAO
+#define CARGA_DISTRIBUICAO  CARGA_UNIFORME
+#endif
+/* 1 = ocupa a CPU durante o serviço, 0 = dorme */
+#ifndef CARGA_OCUPAR
+#define CARGA_OCUPAR        0
+#endif
+/* Forma da distribuição de pareto (> 1 para ter média finita) */
+#ifndef CARGA_PARETO_ALFA
+#define CARGA_PARETO_ALFA   2.5
+#endif
+/* Produtos por segundo de cada produtor na carga aberta (0 = carga fechada) */
+#ifndef CARGA_TAXA
+#define CARGA_TAXA          0
+#endif
+
+#define CARGA_MS(ms) ((uint64_t)(ms) * 1000000ull)
+
+/* Estado do gerador de uma thread (não compartilhar entre threads) */
+typedef struct
+{
+    uint64_t s[4];
+} carga_t;
+
+/* Configuração global, escrita somente em carga_configura() antes das threads */
+static uint64_t carga_semente = CARGA_SEMENTE;
+static int carga_distribuicao = CARGA_DISTRIBUICAO;
+static int carga_ocupar = CARGA_OCUPAR;
+static double carga_escala = 1.0;
+static double carga_taxa = CARGA_TAXA;
+
+
+static inline uint64_t carga_splitmix(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Inicializa o gerador de uma thread, 'fluxo' distingue cada thread (e papel) */
+static inline void carga_inicia(carga_t *c, uint64_t fluxo)
+{
+    uint64_t x = carga_semente ^ (fluxo * 0xd1b54a32d192ed03ull);
+    int i;
+    for (i = 0; i < 4; i++)
+        c->s[i] = carga_splitmix(&x);
+}
+
+static inline uint64_t carga_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/* Próximo valor de 64 bits (xoshiro256**) */
+static inline uint64_t carga_proximo(carga_t *c)
+{
+    uint64_t r = carga_rotl(c->s[1] * 5, 7) * 9;
+    uint64_t t = c->s[1] << 17;
+    c->s[2] ^= c->s[0];
+    c->s[3] ^= c->s[1];
+    c->s[1] ^= c->s[2];
+    c->s[0] ^= c->s[3];
+    c->s[2] ^= t;
+    c->s[3] = carga_rotl(c->s[3], 45);
+    return r;
+}
+
+/* Inteiro uniforme em [0, n) */
+static inline uint64_t carga_intervalo(carga_t *c, uint64_t n)
+{
+    return (uint64_t)(((unsigned __int128)carga_proximo(c) * n) >> 64);
+}
+
+/* Real uniforme em (0, 1] */
+static inline double carga_unitario(carga_t *c)
+{
+    return ((carga_proximo(c) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/* Logaritmo natural (x > 0) */
+static inline double carga_ln(double x)
+{
+    uint64_t bits;
+    double m, t, t2, soma = 0, termo;
+    int e, k;
+
+    memcpy(&bits, &x, sizeof(bits));
+    e = (int)((bits >> 52) & 0x7ff) - 1023;
+    bits = (bits & 0x000fffffffffffffull) | 0x3ff0000000000000ull;
+    memcpy(&m, &bits, sizeof(m)); /* x = m * 2^e, m em [1, 2) */
+
+    /* ln(m) = 2 * (t + t^3/3 + t^5/5 + ...), t = (m - 1) / (m + 1) */
+    t = (m - 1) / (m + 1);
+    t2 = t * t;
+    termo = t;
+    for (k = 1; k < 24; k += 2)
+    {
+        soma += termo / k;
+        termo *= t2;
+    }
+    return 2 * soma + e * 0.69314718055994530942;
+}
+
+/* Exponencial */
+static inline double carga_exp(double y)
+{
+    double r, soma = 1, termo = 1, p2;
+    uint64_t bits;
+    int k, i;
+
+    if (y > 700)
+        y = 700;
+    if (y < -700)
+        return 0;
+    /* e^y = 2^k * e^r, |r| <= ln(2) / 2 */
+    k = (int)(y / 0.69314718055994530942 + (y < 0 ? -0.5 : 0.5));
+    r = y - k * 0.69314718055994530942;
+    for (i = 1; i < 16; i++)
+    {
+        termo *= r / i;
+        soma += termo;
+    }
+    bits = (uint64_t)(k + 1023) << 52;
+    memcpy(&p2, &bits, sizeof(p2));
+    return soma * p2;
+}
+
+/* Sorteia um tempo de serviço (ns) com média 'media_ns' na distribuição configurada */
+static inline uint64_t carga_tempo_ns(carga_t *c, uint64_t media_ns)
+{
+    double media = media_ns * carga_escala, u;
+
+    switch (carga_distribuicao)
+    {
+    case CARGA_CONSTANTE:
+        return (uint64_t)media;
+    case CARGA_EXPONENCIAL:
+        return (uint64_t)(-media * carga_ln(carga_unitario(c)));
+    case CARGA_PARETO:
+        /* Mínimo escolhido para que a média seja 'media' */
+        u = carga_unitario(c);
+        return (uint64_t)(media * (CARGA_PARETO_ALFA - 1) / CARGA_PARETO_ALFA *
+                          carga_exp(-carga_ln(u) / CARGA_PARETO_ALFA));
+    default:
+        return (uint64_t)(media * (0.5 + carga_unitario(c)));
+    }
+}
+
+static inline uint64_t carga_agora_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/* Aguarda até o instante 'prazo' (relógio de carga_agora_ns) dormindo ou ocupando a CPU */
+static inline void carga_espera_ate_ns(uint64_t prazo)
+{
+    struct timespec t;
+
+    if (carga_ocupar)
+    {
+        while (carga_agora_ns() < prazo)
+            ;
+        return;
+    }
+    t.tv_sec = prazo / 1000000000ull;
+    t.tv_nsec = prazo % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL))
+        ;
+}
+
+/* Cumpre 'ns' nanosegundos dormindo (prazo absoluto) ou ocupando a CPU */
+static inline void carga_executa_ns(uint64_t ns)
+{
+    carga_espera_ate_ns(carga_agora_ns() + ns);
+}
+
+/* Intervalo da agenda da carga aberta (ns entre produtos de um produtor) */
+static inline uint64_t carga_periodo_ns(void)
+{
+    return carga_taxa > 0 ? (uint64_t)(1e9 / carga_taxa) : 0;
+}
+
+/* Sorteia e cumpre um tempo de serviço com média 'media_ns' */
+static inline void carga_servico(carga_t *c, uint64_t media_ns)
+{
+    carga_executa_ns(carga_tempo_ns(c, media_ns));
+}
+
+/* Lê as variáveis de ambiente da carga (chamar na main antes das threads) */
+static inline void carga_configura(void)
+{
+    const char *v;
+
+    if ((v = getenv("CARGA_SEMENTE")))
+        carga_semente = strtoull(v, NULL, 0);
+    if ((v = getenv("CARGA_DIST")))
+    {
+        if (!strcmp(v, "constante"))
+            carga_distribuicao = CARGA_CONSTANTE;
+        else if (!strcmp(v, "exponencial"))
+            carga_distribuicao = CARGA_EXPONENCIAL;
+        else if (!strcmp(v, "pareto"))
+            carga_distribuicao = CARGA_PARETO;
+        else
+            carga_distribuicao = CARGA_UNIFORME;
+    }
+    if ((v = getenv("CARGA_ESPERA")))
+        carga_ocupar = !strcmp(v, "ocupar");
+    if ((v = getenv("CARGA_ESCALA")))
+        carga_escala = strtod(v, NULL);
+    if ((v = getenv("CARGA_TAXA")))
+        carga_taxa = strtod(v, NULL);
+}
+
+/* Nome da distribuição em uso (para relatórios) */
+static inline const char *carga_nome_distribuicao(void)
+{
+    static const char *nomes[] = {"uniforme", "constante", "exponencial", "pareto"};
+    return nomes[carga_distribuicao];
+}
+
+#endif
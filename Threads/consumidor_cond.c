@@ -10,143 +10,852 @@
  *  'LIMIT_PROD' eles encerram, os consumidores consumem o resto de produto *
  *  se existir e finalizam, assim esse programa é finalizado.               *
  *                                                                          *
+ * Modo 'MODO_FILA' (compilação com -DMODO_FILA=N):                         *
+ *  0 - FILA_MUTEX: vetor 'produtos' protegido pela mutex 'mutex_m'.        *
+ *  1 - FILA_LOCKFREE: fila limitada MPMC sem trava (lock-free), cada slot  *
+ *      possui número de sequência e os índices ficam em linhas de cache    *
+ *      separadas, threads só dormem com a fila realmente cheia ou vazia.   *
+ *  2 - FILA_FRAGMENTADA: cada consumidor possui sua fila local (fragmento),*
+ *      produtores alimentam os fragmentos em round-robin e consumidores    *
+ *      ociosos roubam pela cauda dos fragmentos dos outros.                *
+ *                                                                          *
+ * Lote 'TAM_LOTE' (compilação com -DTAM_LOTE=K): produtores reservam até K *
+ *  slots e consumidores drenam até K produtos por sessão critica, com um   *
+ *  único sinal para o lote inteiro (padrão K = 1, um produto por vez).     *
+ *                                                                          *
+ * Mensagem 'TAM_MENSAGEM' (compilação com -DTAM_MENSAGEM=B): cada produto  *
+ *  carrega uma mensagem de 1 a B bytes preenchida direto em um bloco do    *
+ *  pool por produtor de 'pool_slab.h', a fila leva somente o ponteiro e o  *
+ *  consumidor devolve o bloco ao pool dono sem passar pelo malloc, com     *
+ *  contadores de cada pool ao final (padrão 0, somente o valor).           *
+ *                                                                          *
+ * Grupo elástico 'ELASTICO' (compilação com -DELASTICO=1): inicia com      *
+ *  MIN_CONS consumidores e o controlador de 'elastico.h' cria até NUM_CONS *
+ *  com produto esperando e nenhum consumidor livre, ou dispensa os ociosos *
+ *  após um tempo sem produto, com os ajustes no log e totais ao final.     *
+ *                                                                          *
+ * Tarefas 'TAREFAS' (compilação com -DTAREFAS=1): produtores e             *
+ *  consumidores viram tarefas M:N de 'tarefas.h' sobre poucos              *
+ *  trabalhadores, a espera na fila estaciona somente a tarefa (NUM_PROD e  *
+ *  NUM_CONS aceitam milhares com -DNUM_CONS=N).                            *
+ *                                                                          *
+ * Afinidade (variável AFINIDADE de 'afinidade.h', compacta, espalhada ou   *
+ *  listas por papel): produtores e consumidores criados na CPU da política *
+ *  e o vetor preso no nó NUMA das Threads, posicionamento no início.       *
+ *                                                                          *
+ * Carga aberta (CARGA_TAXA=N em 'carga.h'): produtores seguem uma agenda   *
+ *  fixa de N produtos por segundo, cada produto leva o instante pretendido *
+ *  de envio e a latência até o consumo é medida a partir dele, assim a     *
+ *  saturação aparece como atraso na fila. Percentis ao final (em ambas).   *
+ *                                                                          *
+ * ** Tempos e valores sorteados por 'carga.h' (gerador por Thread com        *
+ *    semente explícita, mesma semente reproduz a mesma carga).               *
+ * ** Saída das Threads pelo log assíncrono de 'log_assincrono.h',            *
+ *    compilação com -DSEM_LOG remove todo o log.                             *
+ * ** Perfil das travas com -DPERFIL_LOCKS=1 ('perfil_locks.h'), relatório    *
+ *    no final ordenado pela espera total.                                    *
+ * ** Linha do tempo com -DRASTREIO=1 ('rastreio.h'): produção, consumo e     *
+ *    esperas por Thread em JSON para o Perfetto ou o chrome://tracing.       *
  * ** GCC incluir a biblioteca pthread através do parâmetro '-lpthread'       *
  * ** Este Programa Finaliza.                                               *
  *************************************************************************** */
 
+/* sched_getaffinity e pthread_attr_setaffinity_np ('afinidade.h') */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <time.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
-#ifdef _WIN32
-#include <Windows.h>
-#define sleep(ms) Sleep(ms)
-#elif __linux__
-#include <unistd.h>
-#else
-#error "OS Not Supported"
+#include "log_assincrono.h"
+#include "elastico.h"
+#include "afinidade.h"
+
+/* Atores em Threads do sistema (0) ou em tarefas M:N de 'tarefas.h' (1) */
+#ifndef TAREFAS
+#define TAREFAS     0
+#endif
+#if TAREFAS
+/* Após os cabeçalhos com Threads do sistema (log e controlador) e antes da carga (esperas estacionam) */
+#include "tarefas.h"
 #endif
 
-/* Um elemento será inutilizável para distinguir vazio e cheio.  */
+#include "carga.h"
+#include "latencia.h"
+#include "pool_slab.h"
+
+/* Perfil das travas (-DPERFIL_LOCKS=1) e rastreio (-DRASTREIO=1), depois dos outros cabeçalhos */
+#include "rastreio.h"
+#include "perfil_locks.h"
+
+/* Implementações da fila de produção */
+#define FILA_MUTEX     0
+#define FILA_LOCKFREE  1
+#define FILA_FRAGMENTADA 2
+
+/* Seleção da implementação da fila (padrão: mutex) */
+#ifndef MODO_FILA
+#define MODO_FILA   FILA_MUTEX
+#endif
+
+/* Tamanho da linha de cache, usado para separar índices e fragmentos das filas */
+#define TAM_LINHA_CACHE 64
+
+/* Um elemento será inutilizável para distinguir vazio e cheio (somente FILA_MUTEX).  */
 
 /* Número de slots disponíveis pra produzir (buffer size)  */
 #define MAX_PROD    21
 /* Limite de produtos produzidos por cada produtor (produção por thread antes de morrer) */
 #define LIMIT_PROD  10
 
+/* Número máximo de produtos movidos por sessão critica (lote) */
+#ifndef TAM_LOTE
+#define TAM_LOTE    1
+#endif
+
+/* Tamanho máximo da mensagem de cada produto em bytes (0 = somente o valor) */
+#ifndef TAM_MENSAGEM
+#define TAM_MENSAGEM 0
+#endif
+#if TAM_MENSAGEM > POOL_MAX_BLOCO
+#error "TAM_MENSAGEM maior que o bloco do pool (POOL_MAX_BLOCO)"
+#endif
+
+/* Tempo médio entre produções e entre consumos (distribuição em 'carga.h') */
+#define TEMPO_PROD  CARGA_MS(200)
+#define TEMPO_CONS  CARGA_MS(350)
+
 /* Número de Thread rodando função 'void *produtor(void)'       */
+#ifndef NUM_PROD
 #define NUM_PROD    4
+#endif
 /* Número de Thread rodando função 'void *consumidor(void)'     */
+#ifndef NUM_CONS
 #define NUM_CONS    12
+#endif
+
+/* Grupo elástico de consumidores, entre MIN_CONS e NUM_CONS conforme a fila (padrão 0, fixo) */
+#ifndef ELASTICO
+#define ELASTICO    0
+#endif
+#ifndef MIN_CONS
+#define MIN_CONS    1
+#endif
+#if TAREFAS && ELASTICO
+#error "ELASTICO cria Threads do sistema, incompatível com TAREFAS"
+#endif
+#if ELASTICO && NUM_CONS > ELASTICO_MAX
+#error "NUM_CONS acima de ELASTICO_MAX (consumidores no máximo do grupo elástico)"
+#endif
 
+/* Slots de cada fragmento (FILA_FRAGMENTADA), o buffer é dividido entre os consumidores */
+#define MAX_FRAG    ((MAX_PROD + NUM_CONS - 1) / NUM_CONS)
+
+/* Produto no vetor, 'envio' é o instante pretendido de envio (agenda da carga aberta) */
+typedef struct
+{
+    size_t valor;
+    uint64_t envio;
+#if TAM_MENSAGEM
+    unsigned char *mensagem; /* Bloco do pool do produtor (somente o ponteiro passa pela fila) */
+    size_t tam;
+#endif
+} produto_t;
 
 pthread_mutex_t mutex_m, fim_m;      /* Sessão Critica acesso ao vetor 'produtos' e variáveis de índices */
 pthread_cond_t prod_cond, cons_cond; /* Índices de controle dos produtores e consumidores sobre o vetor 'produtos' */
 
-size_t produtos[MAX_PROD]; /* Vetor de produção (sessão critica) */
+#if MODO_FILA == FILA_MUTEX
+produto_t produtos[MAX_PROD]; /* Vetor de produção (sessão critica) */
 size_t len_cons = 0; /* Índice de consumo no vetor 'produtos' (sessão critica) */
 size_t len_prod = 0; /* Índice de produção no vetor 'produtos' (sessão critica) */
+#elif MODO_FILA == FILA_LOCKFREE
+/* Slot da fila, 'seq' informa se o slot está livre para produção ou pronto para consumo */
+typedef struct
+{
+    atomic_size_t seq;
+    produto_t produto;
+} slot_t;
+
+/* Índice isolado em sua própria linha de cache (evita falso compartilhamento) */
+typedef struct
+{
+    _Alignas(TAM_LINHA_CACHE) atomic_size_t v;
+} indice_t;
+
+slot_t produtos[MAX_PROD]; /* Vetor de produção (acesso atômico por slot) */
+indice_t len_cons;         /* Posição absoluta de consumo (cresce sem voltar, slot = pos % MAX_PROD) */
+indice_t len_prod;         /* Posição absoluta de produção (cresce sem voltar, slot = pos % MAX_PROD) */
+#elif MODO_FILA == FILA_FRAGMENTADA
+/*
+    Fila local de um consumidor (anel), o dono retira pela cabeça e os ladrões
+    pela cauda. Cada fragmento fica em suas próprias linhas de cache.
+*/
+typedef struct
+{
+    _Alignas(TAM_LINHA_CACHE) pthread_mutex_t trava;
+    produto_t itens[MAX_FRAG];
+    size_t inicio;             /* Cabeça do anel (sessão critica do fragmento) */
+    atomic_size_t ocupados;    /* Escrito sob 'trava', lido sem trava para pular fragmentos */
+} fragmento_t;
+
+fragmento_t produtos[NUM_CONS];          /* Um fragmento por consumidor */
+_Thread_local size_t prox_fragmento = 0; /* Próximo fragmento a alimentar (por produtor) */
+#else
+#error "MODO_FILA invalido"
+#endif
+
+#if MODO_FILA != FILA_MUTEX
+/* Threads dormindo na fila, permite pular o 'signal' quando ninguém espera */
+atomic_size_t prod_esperando = 0, cons_esperando = 0;
+#endif
 
 size_t fim_flag = 0; /* Flag para encerrar consumidores (fim de todo consumo e fim dos produtores) */
 
+latencia_t latencias[NUM_CONS]; /* Latência do envio ao consumo, uma por consumidor (sem trava) */
 
-void *produtor(void *num_thread)
+#if ELASTICO
+elastico_t elastico; /* Consumidores criados e encerrados pelo controlador de 'elastico.h' */
+#define consumidor_aposenta() elastico_aposenta(&elastico)
+#else
+#define consumidor_aposenta() 0
+#endif
+
+#if TAM_MENSAGEM
+pool_t pools[NUM_PROD]; /* Um pool de mensagens por produtor (existem até o fim dos consumidores) */
+
+/* Sorteia o tamanho e escreve a mensagem no bloco do pool do produtor (sem cópia na fila) */
+void mensagem_cria(produto_t *produto, pool_t *pool, carga_t *carga)
 {
-    /* Semente aleatória para essa Thread (horas mais múltiplos de 60) */
-    srand((size_t)time(NULL) + (*(size_t *)num_thread + 1) * 60);
-    size_t prod_cont = 0;
+    produto->tam = carga_intervalo(carga, TAM_MENSAGEM) + 1;
+    if (!(produto->mensagem = pool_aloca(pool, produto->tam)))
+    {
+        perror("mensagem: pool_aloca");
+        abort();
+    }
+    memset(produto->mensagem, (int)produto->valor, produto->tam);
+}
+
+/* Lê a mensagem no próprio bloco e o devolve ao pool dono, retorna 0 caso esteja corrompida */
+int mensagem_consome(produto_t *produto)
+{
+    size_t i, soma = 0;
+    for (i = 0; i < produto->tam; i++)
+        soma += produto->mensagem[i];
+    pool_libera(NULL, produto->mensagem);
+    return soma == produto->valor * produto->tam;
+}
+#endif
+
+#if MODO_FILA == FILA_LOCKFREE
+/*
+    Tenta inserir 'produto' na fila, retorna 1 em sucesso (grava a posição usada em 'pos_slot')
+    ou 0 caso a fila esteja cheia. O slot está livre para a posição 'pos' quando 'seq == pos'.
+*/
+size_t fila_insere(produto_t produto, size_t *pos_slot)
+{
+    size_t pos = atomic_load_explicit(&len_prod.v, memory_order_relaxed);
     while (1)
     {
-        sleep((rand() % 3 + 1) * 100);
+        slot_t *slot = &produtos[pos % MAX_PROD];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
 
-        /* Sessão critica (Exclusão Mútua)*/
-        pthread_mutex_lock(&mutex_m);
+        if (dif == 0)
+        {
+            /* Slot livre, tenta reservar a posição avançando o índice de produção */
+            if (atomic_compare_exchange_weak_explicit(&len_prod.v, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                slot->produto = produto;
+                /* Publica o produto para os consumidores */
+                atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+                *pos_slot = pos % MAX_PROD;
+                return 1;
+            }
+        }
+        else if (dif < 0)
+        {
+            /* Slot ainda não consumido da volta anterior, fila cheia */
+            return 0;
+        }
+        else
+        {
+            /* Outro produtor pegou a posição, recarrega */
+            pos = atomic_load_explicit(&len_prod.v, memory_order_relaxed);
+        }
+    }
+}
 
-        /* Vetor cheio aguardando por pelo menos um consumidor */
-        while ((len_prod + 1) % MAX_PROD == len_cons)
-            pthread_cond_wait(&prod_cond, &mutex_m);
+/*
+    Tenta remover um produto da fila, retorna 1 em sucesso ou 0 caso a fila esteja vazia.
+    O slot está pronto para consumo na posição 'pos' quando 'seq == pos + 1'.
+*/
+size_t fila_remove(produto_t *produto, size_t *pos_slot)
+{
+    size_t pos = atomic_load_explicit(&len_cons.v, memory_order_relaxed);
+    while (1)
+    {
+        slot_t *slot = &produtos[pos % MAX_PROD];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
 
-        /* Inserindo um valor aleatório entre 1 e 99 (simulando a produção) */
-        produtos[len_prod] = rand() % 99 + 1;
-        prod_cont++;
-        printf("Produzindo: %02d, Pos: %02d, Thread: %02ld (%02d/%02d)\n", produtos[len_prod],
-               len_prod + 1, *(size_t *)num_thread + 1, prod_cont, LIMIT_PROD);
-        len_prod = (len_prod + 1) % MAX_PROD;
+        if (dif == 0)
+        {
+            /* Valor publicado, tenta reservar a posição avançando o índice de consumo */
+            if (atomic_compare_exchange_weak_explicit(&len_cons.v, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                *produto = slot->produto;
+                /* Libera o slot para a próxima volta dos produtores */
+                atomic_store_explicit(&slot->seq, pos + MAX_PROD, memory_order_release);
+                *pos_slot = pos % MAX_PROD;
+                return 1;
+            }
+        }
+        else if (dif < 0)
+        {
+            /* Slot ainda não produzido, fila vazia */
+            return 0;
+        }
+        else
+        {
+            /* Outro consumidor pegou a posição, recarrega */
+            pos = atomic_load_explicit(&len_cons.v, memory_order_relaxed);
+        }
+    }
+}
 
-        /* Produção inserida (libera pelo menos um consumidor) */
-        pthread_cond_signal(&cons_cond);
+#elif MODO_FILA == FILA_FRAGMENTADA
+/*
+    Insere até 'n' valores no primeiro fragmento com espaço, começando pelo
+    próximo da vez desse produtor (round-robin). Retorna quantos valores
+    foram inseridos ou 0 caso todos os fragmentos estejam cheios.
+*/
+size_t fragmento_insere(const produto_t *valores, size_t *posicoes, size_t n)
+{
+    size_t i, k, f, ocupados, slot;
+    fragmento_t *frag;
 
-        /* Fim da sessão critica (Exclusão Mútua)*/
-        pthread_mutex_unlock(&mutex_m);
+    for (k = 0; k < NUM_CONS; k++)
+    {
+        f = (prox_fragmento + k) % NUM_CONS;
+        frag = &produtos[f];
+        /* Pula sem travar os fragmentos cheios */
+        if (atomic_load_explicit(&frag->ocupados, memory_order_relaxed) == MAX_FRAG)
+            continue;
+
+        /* Sessão critica somente do fragmento */
+        pthread_mutex_lock(&frag->trava);
+        ocupados = atomic_load_explicit(&frag->ocupados, memory_order_relaxed);
+        for (i = 0; i < n && ocupados < MAX_FRAG; i++, ocupados++)
+        {
+            slot = (frag->inicio + ocupados) % MAX_FRAG;
+            frag->itens[slot] = valores[i];
+            posicoes[i] = f * MAX_FRAG + slot;
+        }
+        atomic_store_explicit(&frag->ocupados, ocupados, memory_order_relaxed);
+        pthread_mutex_unlock(&frag->trava);
 
-        /* Verifica limite de produção */
-        if (prod_cont == LIMIT_PROD)
+        if (i)
         {
-            printf("Fim do produtor: %02ld\n", *(size_t *)num_thread + 1);
-            pthread_exit(NULL);
-            return NULL; /*opcional*/
+            /* Próximo lote vai para o fragmento seguinte */
+            prox_fragmento = f + 1;
+            return i;
         }
-        
     }
+    return 0;
 }
 
-void *consumidor(void *num_thread)
+/*
+    Remove até 'max' valores, primeiro do próprio fragmento (pela cabeça, ordem
+    de chegada) e caso esteja vazio rouba pela cauda dos outros fragmentos.
+    Retorna quantos valores foram removidos ou 0 caso todos estejam vazios.
+*/
+size_t fragmento_remove(produto_t *valores, size_t *posicoes, size_t max, size_t num_thread)
 {
-    /* Semente aleatória para essa Thread (horas menos múltiplos de 60) */
-    srand((size_t)time(NULL) - (*(size_t *)num_thread + 1) * 60);
-    size_t cons_cont = 0;
-    while (1)
+    size_t n = 0, k, f, ocupados, slot;
+    fragmento_t *frag;
+
+    for (k = 0; k < NUM_CONS && n == 0; k++)
     {
-        sleep((rand() % 4 + 2) * 100);
+        f = (num_thread + k) % NUM_CONS;
+        frag = &produtos[f];
+        /* Pula sem travar os fragmentos vazios */
+        if (atomic_load_explicit(&frag->ocupados, memory_order_relaxed) == 0)
+            continue;
+
+        /* Sessão critica somente do fragmento */
+        pthread_mutex_lock(&frag->trava);
+        ocupados = atomic_load_explicit(&frag->ocupados, memory_order_relaxed);
+        for (; n < max && ocupados; n++, ocupados--)
+        {
+            if (k == 0)
+            {
+                /* Dono retira pela cabeça */
+                slot = frag->inicio;
+                frag->inicio = (frag->inicio + 1) % MAX_FRAG;
+            }
+            else
+            {
+                /* Ladrão retira pela cauda */
+                slot = (frag->inicio + ocupados - 1) % MAX_FRAG;
+            }
+            valores[n] = frag->itens[slot];
+            posicoes[n] = f * MAX_FRAG + slot;
+        }
+        atomic_store_explicit(&frag->ocupados, ocupados, memory_order_relaxed);
+        pthread_mutex_unlock(&frag->trava);
+    }
+    return n;
+}
+#endif
 
-        /* Sessão critica (Exclusão Mútua)*/
+#if MODO_FILA != FILA_MUTEX
+/*
+    Acorda uma thread da condicional somente se existir alguma esperando.
+    A barreira garante que a publicação na fila seja vista antes da leitura
+    do contador de espera (par com a barreira de quem vai dormir).
+*/
+void acorda_se_esperando(atomic_size_t *esperando, pthread_cond_t *cond)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(esperando, memory_order_relaxed))
+    {
         pthread_mutex_lock(&mutex_m);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&mutex_m);
+    }
+}
+#endif
+
+#if ELASTICO
+/* Produtos no vetor (leitura para o controlador do grupo elástico) */
+size_t fila_ocupacao(void)
+{
+#if MODO_FILA == FILA_MUTEX
+    size_t ocupados;
+    pthread_mutex_lock(&mutex_m);
+    ocupados = (len_prod + MAX_PROD - len_cons) % MAX_PROD;
+    pthread_mutex_unlock(&mutex_m);
+    return ocupados;
+#elif MODO_FILA == FILA_LOCKFREE
+    /* Consumo lido antes da produção, a diferença nunca fica negativa */
+    size_t cons = atomic_load(&len_cons.v);
+    return atomic_load(&len_prod.v) - cons;
+#elif MODO_FILA == FILA_FRAGMENTADA
+    size_t i, ocupados = 0;
+    for (i = 0; i < NUM_CONS; i++)
+        ocupados += atomic_load_explicit(&produtos[i].ocupados, memory_order_relaxed);
+    return ocupados;
+#endif
+}
 
+/* Acorda um consumidor travado para atender o pedido de encerramento */
+void acorda_consumidor(void)
+{
+    pthread_mutex_lock(&mutex_m);
+    pthread_cond_signal(&cons_cond);
+    pthread_mutex_unlock(&mutex_m);
+}
+#endif
+
+/*
+    API de lote (produção): insere até 'n' valores em slots contíguos do vetor em
+    uma única sessão critica, bloqueia somente enquanto a fila estiver cheia.
+    Retorna quantos valores foram inseridos (pode ser menor que 'n' caso falte
+    espaço) e grava o slot de cada valor em 'posicoes'. Um único sinal acorda
+    consumidor para o lote inteiro.
+*/
+size_t insere_lote(const produto_t *valores, size_t *posicoes, size_t n)
+{
+#if MODO_FILA == FILA_MUTEX
+    size_t i, livres;
+
+    /* Sessão critica (Exclusão Mútua)*/
+    pthread_mutex_lock(&mutex_m);
+
+    /* Vetor cheio aguardando por pelo menos um consumidor */
+    while ((len_prod + 1) % MAX_PROD == len_cons)
+        pthread_cond_wait(&prod_cond, &mutex_m);
+
+    /* Reserva os slots livres do lote (um continua inutilizável) */
+    livres = (len_cons + MAX_PROD - len_prod - 1) % MAX_PROD;
+    if (n > livres)
+        n = livres;
+    for (i = 0; i < n; i++)
+    {
+        produtos[len_prod] = valores[i];
+        posicoes[i] = len_prod;
+        len_prod = (len_prod + 1) % MAX_PROD;
+    }
+
+    /* Produção inserida (um único sinal para o lote inteiro) */
+    pthread_cond_signal(&cons_cond);
+    /* Ainda sobrou espaço, passa a vez para outro produtor travado */
+    if (livres > n)
+        pthread_cond_signal(&prod_cond);
+
+    /* Fim da sessão critica (Exclusão Mútua)*/
+    pthread_mutex_unlock(&mutex_m);
+    return n;
+#elif MODO_FILA == FILA_LOCKFREE
+    size_t i;
+
+    /* Caminho rápido sem trava, a mutex só é usada com a fila cheia */
+    if (!fila_insere(valores[0], &posicoes[0]))
+    {
+        pthread_mutex_lock(&mutex_m);
+        /* Registra a espera antes de testar novamente (não perde o sinal do consumidor) */
+        atomic_fetch_add(&prod_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        /* Vetor cheio aguardando por pelo menos um consumidor */
+        while (!fila_insere(valores[0], &posicoes[0]))
+            pthread_cond_wait(&prod_cond, &mutex_m);
+        atomic_fetch_sub(&prod_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
+    /* Restante do lote somente enquanto houver espaço (sem bloquear) */
+    for (i = 1; i < n && fila_insere(valores[i], &posicoes[i]); i++)
+        ;
+
+    /* Produção inserida (libera um consumidor caso exista algum dormindo) */
+    acorda_se_esperando(&cons_esperando, &cons_cond);
+    return i;
+#elif MODO_FILA == FILA_FRAGMENTADA
+    size_t i;
+
+    /* Caminho rápido, somente a trava de um fragmento */
+    if ((i = fragmento_insere(valores, posicoes, n)) == 0)
+    {
+        pthread_mutex_lock(&mutex_m);
+        /* Registra a espera antes de testar novamente (não perde o sinal do consumidor) */
+        atomic_fetch_add(&prod_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        /* Todos os fragmentos cheios aguardando por pelo menos um consumidor */
+        while ((i = fragmento_insere(valores, posicoes, n)) == 0)
+            pthread_cond_wait(&prod_cond, &mutex_m);
+        atomic_fetch_sub(&prod_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
+
+    /* Produção inserida (libera um consumidor caso exista algum dormindo) */
+    acorda_se_esperando(&cons_esperando, &cons_cond);
+    return i;
+#endif
+}
+
+/*
+    API de lote (consumo): remove até 'max' valores em uma única sessão critica,
+    bloqueia enquanto a fila estiver vazia. Retorna quantos valores foram
+    removidos ou 0 caso a fila esteja vazia e a produção tenha encerrado
+    ('fim_flag'). Um único sinal acorda produtor para o lote inteiro.
+*/
+size_t remove_lote(produto_t *valores, size_t *posicoes, size_t max, size_t num_thread)
+{
+#if MODO_FILA == FILA_MUTEX
+    size_t n = 0;
+
+    /* Sessão critica (Exclusão Mútua)*/
+    pthread_mutex_lock(&mutex_m);
+
+    /* Vetor vazio aguardando por pelo menos um produtor */
+    while (len_cons == len_prod)
+    {
+        /* Verifica encerramento dos produtores (ou pedido de encerramento do grupo elástico) */
+        pthread_mutex_lock(&fim_m);
+        if (fim_flag || consumidor_aposenta())
+        {
+            pthread_mutex_unlock(&fim_m);
+            pthread_mutex_unlock(&mutex_m);
+            return 0;
+        }
+        LOG("Consumidor %02ld travado\n", num_thread + 1);
+        pthread_mutex_unlock(&fim_m);
+        /* Aguarda produção (Produtores existentes ainda) */
+        pthread_cond_wait(&cons_cond, &mutex_m);
+    }
+
+    /* Drena até 'max' produtos de uma vez */
+    while (n < max && len_cons != len_prod)
+    {
+        valores[n] = produtos[len_cons];
+        posicoes[n] = len_cons;
+        len_cons = (len_cons + 1) % MAX_PROD;
+        n++;
+    }
+
+    /* Consumido (um único sinal libera produtor para todos os slots do lote) */
+    pthread_cond_signal(&prod_cond);
+    /* Ainda restam produtos, passa a vez para outro consumidor travado */
+    if (len_cons != len_prod)
+        pthread_cond_signal(&cons_cond);
+
+    /* Fim sessão critica (Exclusão Mútua)*/
+    pthread_mutex_unlock(&mutex_m);
+    return n;
+#elif MODO_FILA == FILA_LOCKFREE
+    size_t n;
+
+    /* Caminho rápido sem trava, a mutex só é usada com a fila vazia */
+    if (!fila_remove(&valores[0], &posicoes[0]))
+    {
+        pthread_mutex_lock(&mutex_m);
+        /* Registra a espera antes de testar novamente (não perde o sinal do produtor) */
+        atomic_fetch_add(&cons_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
         /* Vetor vazio aguardando por pelo menos um produtor */
-        while (len_cons == len_prod)
+        while (!fila_remove(&valores[0], &posicoes[0]))
         {
-            /* Verifica encerramento dos produtores */
+            /* Verifica encerramento dos produtores (fila vazia e sem produtores = fim) ou pedido do grupo elástico */
             pthread_mutex_lock(&fim_m);
-            if (fim_flag)
+            if (fim_flag || consumidor_aposenta())
             {
                 pthread_mutex_unlock(&fim_m);
+                atomic_fetch_sub(&cons_esperando, 1);
                 pthread_mutex_unlock(&mutex_m);
-                printf("Fim do consumidor: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
-                pthread_exit(NULL);
-                return NULL; /*opcional*/
+                return 0;
             }
-            printf("Consumidor %02ld travado\n", *(size_t *)num_thread + 1);
+            LOG("Consumidor %02ld travado\n", num_thread + 1);
             pthread_mutex_unlock(&fim_m);
             /* Aguarda produção (Produtores existentes ainda) */
             pthread_cond_wait(&cons_cond, &mutex_m);
         }
+        atomic_fetch_sub(&cons_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
+    /* Restante do lote somente enquanto houver produto (sem bloquear) */
+    for (n = 1; n < max && fila_remove(&valores[n], &posicoes[n]); n++)
+        ;
+
+    /* Consumido (libera um produtor caso exista algum dormindo) */
+    acorda_se_esperando(&prod_esperando, &prod_cond);
+    /* Lote cheio, pode ter sobrado produto para outro consumidor dormindo */
+    if (max > 1 && n == max)
+        acorda_se_esperando(&cons_esperando, &cons_cond);
+    return n;
+#elif MODO_FILA == FILA_FRAGMENTADA
+    size_t n;
+
+    /* Caminho rápido, somente travas dos fragmentos */
+    if ((n = fragmento_remove(valores, posicoes, max, num_thread)) == 0)
+    {
+        pthread_mutex_lock(&mutex_m);
+        /* Registra a espera antes de testar novamente (não perde o sinal do produtor) */
+        atomic_fetch_add(&cons_esperando, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        /* Todos os fragmentos vazios aguardando por pelo menos um produtor */
+        while ((n = fragmento_remove(valores, posicoes, max, num_thread)) == 0)
+        {
+            /* Verifica encerramento dos produtores (fragmentos vazios e sem produtores = fim) ou pedido do grupo elástico */
+            pthread_mutex_lock(&fim_m);
+            if (fim_flag || consumidor_aposenta())
+            {
+                pthread_mutex_unlock(&fim_m);
+                atomic_fetch_sub(&cons_esperando, 1);
+                pthread_mutex_unlock(&mutex_m);
+                return 0;
+            }
+            LOG("Consumidor %02ld travado\n", num_thread + 1);
+            pthread_mutex_unlock(&fim_m);
+            /* Aguarda produção (Produtores existentes ainda) */
+            pthread_cond_wait(&cons_cond, &mutex_m);
+        }
+        atomic_fetch_sub(&cons_esperando, 1);
+        pthread_mutex_unlock(&mutex_m);
+    }
 
-        /* Consumindo (simulando o consumo) */
-        cons_cont++;
-        printf("Consumindo: %02d, pos: %02d, Thread: %02ld (%02ld)\n", produtos[len_cons],
-                len_cons + 1, *(size_t *)num_thread + 1, cons_cont);
-        len_cons = (len_cons + 1) % MAX_PROD;
+    /* Consumido (libera um produtor caso exista algum dormindo) */
+    acorda_se_esperando(&prod_esperando, &prod_cond);
+    return n;
+#endif
+}
 
-        /* Consumido (libera um produtor caso esses já tenham enchido o vetor) */
-        pthread_cond_signal(&prod_cond);
+void *produtor(void *num_thread)
+{
+    /* Gerador de carga dessa Thread (semente da execução + número da Thread) */
+    carga_t carga;
+    carga_inicia(&carga, *(size_t *)num_thread);
+    RASTREIO_THREAD("produtor", *(size_t *)num_thread + 1);
+    size_t prod_cont = 0, i, n, lim;
+    produto_t valores[TAM_LOTE];
+    size_t posicoes[TAM_LOTE];
+    /* Agenda da carga aberta, instante pretendido do próximo produto */
+    uint64_t periodo = carga_periodo_ns(), proximo = carga_agora_ns() + periodo, agora;
+#if TAM_MENSAGEM
+    pool_t *pool = &pools[*(size_t *)num_thread];
+#endif
+#if MODO_FILA == FILA_FRAGMENTADA
+    /* Afinidade inicial, cada produtor começa por um fragmento diferente */
+    prox_fragmento = *(size_t *)num_thread % NUM_CONS;
+#endif
+    while (1)
+    {
+        /* Lote limitado pelo restante da produção dessa Thread */
+        lim = LIMIT_PROD - prod_cont;
+        if (lim > TAM_LOTE)
+            lim = TAM_LOTE;
 
-        /* Fim sessão critica (Exclusão Mútua)*/
-        pthread_mutex_unlock(&mutex_m);
+        if (periodo)
+        {
+            /* Carga aberta, aguarda o instante pretendido (não espera se estiver atrasado) */
+            carga_espera_ate_ns(proximo);
+            RASTREIO_INICIO("produz");
+            agora = carga_agora_ns();
+            /* Todos os produtos já vencidos na agenda entram no lote (o atraso não some) */
+            for (n = 0; n < lim && proximo + n * periodo <= agora; n++)
+                valores[n].envio = proximo + n * periodo;
+        }
+        else
+        {
+            /* Carga fechada, o próximo lote só é produzido após inserir o anterior, um tempo
+               de produção por item (o tamanho do lote não muda a carga oferecida) */
+            RASTREIO_INICIO("produz");
+            for (n = 0; n < lim; n++)
+            {
+                carga_servico(&carga, TEMPO_PROD);
+                valores[n].envio = carga_agora_ns();
+            }
+        }
+
+        /* Valores aleatórios entre 1 e 99 (simulando a produção) */
+        for (i = 0; i < n; i++)
+        {
+            valores[i].valor = carga_intervalo(&carga, 99) + 1;
+#if TAM_MENSAGEM
+            mensagem_cria(&valores[i], pool, &carga);
+#endif
+        }
+
+        RASTREIO_FIM("produz");
+
+        /* Insere o lote (uma sessão critica e um sinal para todo o lote) */
+        lim = n;
+        RASTREIO_INICIO("insere");
+        n = insere_lote(valores, posicoes, n);
+        RASTREIO_FIM("insere");
+#if TAM_MENSAGEM
+        /* Mensagens que não couberam voltam para o pool (liberação local) */
+        for (i = n; i < lim; i++)
+            pool_libera(pool, valores[i].mensagem);
+#endif
+        /* Avança a agenda somente pelo que foi inserido, o resto mantém o instante pretendido */
+        proximo += n * periodo;
+
+        for (i = 0; i < n; i++)
+        {
+            prod_cont++;
+            LOG("Produzindo: %02ld, Pos: %02ld, Thread: %02ld (%02ld/%02ld)\n", valores[i].valor,
+                   posicoes[i] + 1, *(size_t *)num_thread + 1, prod_cont, LIMIT_PROD);
+        }
+
+        /* Verifica limite de produção */
+        if (prod_cont == LIMIT_PROD)
+        {
+            LOG("Fim do produtor: %02ld\n", *(size_t *)num_thread + 1);
+            pthread_exit(NULL);
+            return NULL; /*opcional*/
+        }
+    }
+}
+
+void *consumidor(void *num_thread)
+{
+    /* Gerador de carga dessa Thread (fluxos após os dos produtores) */
+    carga_t carga;
+    carga_inicia(&carga, NUM_PROD + *(size_t *)num_thread);
+    RASTREIO_THREAD("consumidor", *(size_t *)num_thread + 1);
+    size_t cons_cont = 0, i, n;
+    /* Produtos do último lote, o consumo de cada um é simulado antes de drenar o próximo */
+    size_t ultimo_lote = 1;
+    produto_t valores[TAM_LOTE];
+    size_t posicoes[TAM_LOTE];
+    uint64_t agora;
+    latencia_t *lat = &latencias[*(size_t *)num_thread];
+    while (1)
+    {
+        RASTREIO_INICIO("consome");
+        for (i = 0; i < ultimo_lote; i++)
+            carga_servico(&carga, TEMPO_CONS);
+        RASTREIO_FIM("consome");
+
+        /* Drena até 'TAM_LOTE' produtos (uma sessão critica e um sinal para todo o lote) */
+        RASTREIO_INICIO("remove");
+#if ELASTICO
+        elastico_ocioso(&elastico, 1);
+        n = remove_lote(valores, posicoes, TAM_LOTE, *(size_t *)num_thread);
+        elastico_ocioso(&elastico, -1);
+#else
+        n = remove_lote(valores, posicoes, TAM_LOTE, *(size_t *)num_thread);
+#endif
+        RASTREIO_FIM("remove");
+
+        /* Fila vazia e produtores encerrados (ou consumidor dispensado pelo grupo elástico) */
+        if (n == 0)
+        {
+#if ELASTICO
+            if (elastico_aposentado)
+                LOG("Consumidor aposentado: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
+            else
+                LOG("Fim do consumidor: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
+            elastico_sai(&elastico, *(size_t *)num_thread);
+#else
+            LOG("Fim do consumidor: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
+#endif
+            pthread_exit(NULL);
+            return NULL; /*opcional*/
+        }
+        ultimo_lote = n;
+
+        /* Latência desde o instante pretendido de envio (inclui o tempo travado na fila cheia) */
+        agora = carga_agora_ns();
+        for (i = 0; i < n; i++)
+        {
+            latencia_registra(lat, agora - valores[i].envio);
+#if ELASTICO
+            /* Maior espera na fila, sinal para o controlador criar consumidores */
+            elastico_registra_espera(&elastico, agora - valores[i].envio);
+#endif
+        }
+
+#if TAM_MENSAGEM
+        for (i = 0; i < n; i++)
+            if (!mensagem_consome(&valores[i]))
+                LOG("Mensagem corrompida: %02ld, Thread: %02ld\n", valores[i].valor,
+                    *(size_t *)num_thread + 1);
+#endif
+
+        /* Consumindo (simulando o consumo) */
+        for (i = 0; i < n; i++)
+        {
+            cons_cont++;
+            LOG("Consumindo: %02ld, pos: %02ld, Thread: %02ld (%02ld)\n", valores[i].valor,
+                    posicoes[i] + 1, *(size_t *)num_thread + 1, cons_cont);
+        }
     }
 }
 
-int main(int argc, char const *argv[])
+int main(void)
 {
     /* Variável para iterações com FOR */
     size_t i;
     /* Threads da produção e consumidores */
-    pthread_t prodT[NUM_PROD], consT[NUM_CONS];
+    pthread_t prodT[NUM_PROD];
+    /* Atributos de afinidade de cada criação */
+    pthread_attr_t atributos;
 
     /* Enumera cada Thread produtora pra contar produção de cada */
-    size_t num_prod_thread[NUM_PROD], num_cons_thread[NUM_CONS];
+    size_t num_prod_thread[NUM_PROD];
+#if !ELASTICO
+    /* Consumidores fixos (no grupo elástico ficam em 'elastico') */
+    pthread_t consT[NUM_CONS];
+    size_t num_cons_thread[NUM_CONS];
+#endif
 
     /* Inicialização da Mutex e Mutex condicionais */
     pthread_mutex_init(&mutex_m, NULL);
@@ -154,24 +863,80 @@ int main(int argc, char const *argv[])
     pthread_cond_init(&prod_cond, NULL);
     pthread_cond_init(&cons_cond, NULL);
 
+#if MODO_FILA == FILA_LOCKFREE
+    /* Cada slot começa livre para a produção da sua própria posição */
+    for (i = 0; i < MAX_PROD; i++)
+        atomic_init(&produtos[i].seq, i);
+    atomic_init(&len_cons.v, 0);
+    atomic_init(&len_prod.v, 0);
+#elif MODO_FILA == FILA_FRAGMENTADA
+    for (i = 0; i < NUM_CONS; i++)
+    {
+        pthread_mutex_init(&produtos[i].trava, NULL);
+        produtos[i].inicio = 0;
+        atomic_init(&produtos[i].ocupados, 0);
+    }
+#endif
+
+    /* Semente e distribuição da carga (variáveis CARGA_* de ambiente) */
+    carga_configura();
+    /* Posicionamento das Threads (variável AFINIDADE), papéis na ordem de criação */
+    if (afinidade_configura(NULL) < 0)
+    {
+        fprintf(stderr, "AFINIDADE invalida: '%s'\n", getenv("AFINIDADE"));
+        return 1;
+    }
+    afinidade_papel(AFINIDADE_CONSUMIDOR, NUM_CONS);
+    afinidade_papel(AFINIDADE_PRODUTOR, NUM_PROD);
+    /* Vetor de produção no nó NUMA das Threads (move as páginas já tocadas na inicialização) */
+    afinidade_memoria(produtos, sizeof(produtos));
+#if TAM_MENSAGEM
+    for (i = 0; i < NUM_PROD; i++)
+        pool_inicia(&pools[i]);
+#endif
+    printf("Semente: %llu, distribuicao: %s\n", (unsigned long long)carga_semente,
+           carga_nome_distribuicao());
+    afinidade_relatorio();
+    if (carga_taxa > 0)
+        printf("Carga aberta: %.1f produtos/s por produtor\n", carga_taxa);
+    else
+        printf("Carga fechada\n");
+
     printf("Inicia...\n\n");
 
+    /* Escritor de fundo do log (antes das Threads) */
+    log_inicia();
+
     /* Inicialização das Threads (inicia condições de corrida) */
+#if ELASTICO
+    /* Somente MIN_CONS consumidores, o controlador cria os demais conforme a fila */
+    elastico_inicia(&elastico, MIN_CONS, NUM_CONS, consumidor, fila_ocupacao, acorda_consumidor);
+#else
     for (i = 0; i < NUM_CONS; i++)
     {
         num_cons_thread[i] = i;
-        pthread_create((consT + i), NULL, (void *)&consumidor, (void *)(num_cons_thread + i));
+        pthread_create((consT + i), afinidade_attr(&atributos, AFINIDADE_CONSUMIDOR, i),
+                       (void *)&consumidor, (void *)(num_cons_thread + i));
+        pthread_attr_destroy(&atributos);
     }
+#endif
     for (i = 0; i < NUM_PROD; i++)
     {
         num_prod_thread[i] = i;
-        pthread_create((prodT + i), NULL, (void *)&produtor, (void *)(num_prod_thread + i));
+        pthread_create((prodT + i), afinidade_attr(&atributos, AFINIDADE_PRODUTOR, i),
+                       (void *)&produtor, (void *)(num_prod_thread + i));
+        pthread_attr_destroy(&atributos);
     }
 
     /* Aguarda fim das Threads produtoras */
     for (i = 0; i < NUM_PROD; i++)
         pthread_join(prodT[i], NULL);
 
+#if ELASTICO
+    /* Encerra o controlador, os consumidores existentes drenam o restante */
+    elastico_para(&elastico);
+#endif
+
     /* Sinaliza fim da produção para consumidores */
     pthread_mutex_lock(&fim_m);
     fim_flag = 1;
@@ -190,13 +955,48 @@ int main(int argc, char const *argv[])
     pthread_mutex_unlock(&mutex_m);
 
     /* Aguarda fim das Threads consumidoras */
+#if ELASTICO
+    elastico_aguarda(&elastico);
+#else
     for (i = 0; i < NUM_CONS; i++)
         pthread_join(consT[i], NULL);
+#endif
+
+    /* Escreve o restante do log (Threads já encerradas) */
+    log_finaliza();
 
     printf("\nFim\n");
 
+    /* Latência de todos os consumidores (envio pretendido até o consumo) */
+    for (i = 1; i < NUM_CONS; i++)
+        latencia_junta(&latencias[0], &latencias[i]);
+    latencia_relatorio(&latencias[0], "envio-consumo");
+    perfil_relatorio();
+    RASTREIO_EXPORTA();
+#if ELASTICO
+    elastico_relatorio(&elastico);
+#endif
+#if TAREFAS
+    tarefas_relatorio();
+#endif
+
+#if TAM_MENSAGEM
+    /* Pools já sem blocos em uso (todos os consumidores encerraram) */
+    for (i = 0; i < NUM_PROD; i++)
+    {
+        char nome[16];
+        snprintf(nome, sizeof(nome), "produtor %02zu", i + 1);
+        pool_relatorio(&pools[i], nome);
+        pool_destroi(&pools[i]);
+    }
+#endif
+
     pthread_mutex_destroy(&mutex_m);
     pthread_mutex_destroy(&fim_m);
+#if MODO_FILA == FILA_FRAGMENTADA
+    for (i = 0; i < NUM_CONS; i++)
+        pthread_mutex_destroy(&produtos[i].trava);
+#endif
     pthread_cond_destroy(&prod_cond);
     pthread_cond_destroy(&cons_cond);
 
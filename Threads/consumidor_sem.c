@@ -9,10 +9,68 @@
  *  leitura (consumo) e escrita (produção), porém a sincronização entre     *
  *  entre produtores e consumidores será feita por semaforos                *
  *                                                                          *
+ * Lote 'TAM_LOTE' (compilação com -DTAM_LOTE=K): produtores reservam até K *
+ *  slots e consumidores drenam até K produtos por sessão critica, com um   *
+ *  único sem_post para o lote inteiro (padrão K = 1, um produto por vez).  *
+ *  Os semáforos passam a ser os avisos de lote de 'anel_lote.h'.           *
+ *                                                                          *
+ * Semáforo 'USA_FUTEX' (compilação com -DUSA_FUTEX=1): troca o 'sem_t'     *
+ *  pelo semáforo de 'futex_sem.h', que gira antes de dormir no kernel e    *
+ *  só acorda quando existe alguém esperando, contadores ao final.          *
+ *                                                                          *
+ * Mensagem 'TAM_MENSAGEM' (compilação com -DTAM_MENSAGEM=B): cada produto  *
+ *  carrega uma mensagem de 1 a B bytes preenchida direto em um bloco do    *
+ *  pool por produtor de 'pool_slab.h', a fila leva somente o ponteiro e o  *
+ *  consumidor devolve o bloco ao pool dono sem passar pelo malloc, com     *
+ *  contadores de cada pool ao final (padrão 0, somente o valor).           *
+ *                                                                          *
+ * Processos 'MODO_PROCESSOS' (compilação com -DMODO_PROCESSOS=1): cada     *
+ *  produtor e consumidor é um processo, o vetor, índices, mutex e          *
+ *  semáforos ficam no segmento de memória compartilhada NOME_SHM           *
+ *  (shm_open e mmap, objetos com pshared). A mutex é robusta, quem pega a  *
+ *  mutex de um processo que morreu refaz 'ocupados' antes de seguir, e a   *
+ *  main recria o processo encerrado por sinal (o produtor retoma do seu    *
+ *  progresso no segmento). Processos avulsos entram na fila já criada com  *
+ *  'consumidor_sem produtor N' ou 'consumidor_sem consumidor N'.           *
+ *                                                                          *
+ * Grupo elástico 'ELASTICO' (compilação com -DELASTICO=1): inicia com      *
+ *  MIN_CONS consumidores e o controlador de 'elastico.h' cria até NUM_CONS *
+ *  com produto esperando e nenhum consumidor livre, ou dispensa os ociosos *
+ *  com um aviso extra em 'cons_s' após um tempo sem produto, com os        *
+ *  ajustes no log e totais ao final (somente no modo Threads).             *
+ *                                                                          *
+ * Tarefas 'TAREFAS' (compilação com -DTAREFAS=1): produtores e             *
+ *  consumidores viram tarefas M:N de 'tarefas.h' sobre poucos              *
+ *  trabalhadores, a espera na fila estaciona somente a tarefa (NUM_PROD e  *
+ *  NUM_CONS aceitam milhares com -DNUM_CONS=N).                            *
+ *                                                                          *
+ * Afinidade (variável AFINIDADE de 'afinidade.h', compacta, espalhada ou   *
+ *  listas por papel): produtores e consumidores criados na CPU da política *
+ *  e o vetor preso no nó NUMA das Threads, posicionamento no início.       *
+ *                                                                          *
+ * Carga aberta (CARGA_TAXA=N em 'carga.h'): produtores seguem uma agenda   *
+ *  fixa de N produtos por segundo, cada produto leva o instante pretendido *
+ *  de envio e a latência até o consumo é medida a partir dele, assim a     *
+ *  saturação aparece como atraso na fila. Percentis ao final (em ambas).   *
+ *                                                                          *
+ * ** Tempos e valores sorteados por 'carga.h' (gerador por Thread com      *
+ *    semente explícita, mesma semente reproduz a mesma carga).             *
+ * ** Saída das Threads pelo log assíncrono de 'log_assincrono.h',          *
+ *    compilação com -DSEM_LOG remove todo o log.                           *
+ * ** Perfil das travas com -DPERFIL_LOCKS=1 ('perfil_locks.h'), relatório  *
+ *    no final ordenado pela espera total (com MODO_PROCESSOS um por        *
+ *    processo, após o pid).                                                *
+ * ** Linha do tempo com -DRASTREIO=1 ('rastreio.h'): produção, consumo e   *
+ *    esperas por Thread em JSON para o Perfetto ou o chrome://tracing (no  *
+ *    MODO_PROCESSOS um arquivo 'rastreio.PID.json' por processo).          *
  * ** GCC incluir a biblioteca pthread através do parâmetro '-lpthread'     *
+ *    (e '-lrt' para o shm_open em glibc anterior a 2.34)                   *
  * ** Este Programa Finaliza.                                               *
  *************************************************************************** */
 
+/* sched_getaffinity e pthread_attr_setaffinity_np ('afinidade.h') */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,161 +78,828 @@
 #include <semaphore.h>
 #include <time.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "log_assincrono.h"
+#include "elastico.h"
+#include "afinidade.h"
+
+/* Atores em Threads do sistema (0) ou em tarefas M:N de 'tarefas.h' (1) */
+#ifndef TAREFAS
+#define TAREFAS     0
+#endif
+#if TAREFAS
+/* Após os cabeçalhos com Threads do sistema (log e controlador) e antes da carga (esperas estacionam) */
+#include "tarefas.h"
+#endif
 
-#ifdef _WIN32
-#include <Windows.h>
-#define sleep(ms) Sleep(ms)
-#elif __linux__
-#include <unistd.h>
+#include "carga.h"
+#include "latencia.h"
+#include "pool_slab.h"
+#include "anel_lote.h"
+
+/* Semáforo usado: 0 = sem_t (POSIX), 1 = futex_sem_t (futex com giro adaptativo) */
+#ifndef USA_FUTEX
+#define USA_FUTEX   0
+#endif
+
+#if USA_FUTEX
+#include "futex_sem.h"
+typedef futex_sem_t semaforo_t;
+#define semaforo_init     futex_sem_init
+#define semaforo_wait     futex_sem_wait
+#define semaforo_post     futex_sem_post
+#define semaforo_destroy  futex_sem_destroy
 #else
-#error "OS Not Supported"
+typedef sem_t semaforo_t;
+#define semaforo_init     sem_init
+#define semaforo_wait     sem_wait
+#define semaforo_post     sem_post
+#define semaforo_destroy  sem_destroy
 #endif
 
+/* Perfil das travas (-DPERFIL_LOCKS=1) e rastreio (-DRASTREIO=1), depois dos outros cabeçalhos */
+#include "rastreio.h"
+#include "perfil_locks.h"
 
 /* Número de slots disponíveis para produzir (buffer size)  */
 #define MAX_PROD    20
 /* Limite de produtos produzidos por cada produtor (produção necessária antes de morrer) */
 #define LIMIT_PROD  10
 
+/* Número máximo de produtos movidos por sessão critica (lote) */
+#ifndef TAM_LOTE
+#define TAM_LOTE    1
+#endif
+
+/* Tamanho máximo da mensagem de cada produto em bytes (0 = somente o valor) */
+#ifndef TAM_MENSAGEM
+#define TAM_MENSAGEM 0
+#endif
+#if TAM_MENSAGEM > POOL_MAX_BLOCO
+#error "TAM_MENSAGEM maior que o bloco do pool (POOL_MAX_BLOCO)"
+#endif
+
+/* Produtores e consumidores: 0 = Threads de um processo, 1 = processos com a fila em shm */
+#ifndef MODO_PROCESSOS
+#define MODO_PROCESSOS 0
+#endif
+#if TAREFAS && (MODO_PROCESSOS || USA_FUTEX)
+#error "TAREFAS usa o semáforo das tarefas dentro de um único processo"
+#endif
+#if MODO_PROCESSOS && TAM_MENSAGEM
+#error "TAM_MENSAGEM usa pools na memória de cada processo, incompatível com MODO_PROCESSOS"
+#endif
+
+/* Nome do segmento de memória compartilhada (MODO_PROCESSOS) */
+#define NOME_SHM    "/consumidor_sem"
+
+/* Papel de cada processo (MODO_PROCESSOS) */
+#define PAPEL_PRODUTOR    1
+#define PAPEL_CONSUMIDOR  2
+
+/* Tempo médio entre produções e entre consumos (distribuição em 'carga.h') */
+#define TEMPO_PROD  CARGA_MS(200)
+#define TEMPO_CONS  CARGA_MS(350)
+
 /* Número de Thread rodando função 'void *produtor(void)'       */
+#ifndef NUM_PROD
 #define NUM_PROD    4
+#endif
 /* Número de Thread rodando função 'void *consumidor(void)'     */
+#ifndef NUM_CONS
 #define NUM_CONS    12
+#endif
 
+/* Grupo elástico de consumidores, entre MIN_CONS e NUM_CONS conforme a fila (padrão 0, fixo) */
+#ifndef ELASTICO
+#define ELASTICO    0
+#endif
+#ifndef MIN_CONS
+#define MIN_CONS    1
+#endif
+#if TAREFAS && ELASTICO
+#error "ELASTICO cria Threads do sistema, incompatível com TAREFAS"
+#endif
+#if ELASTICO && NUM_CONS > ELASTICO_MAX
+#error "NUM_CONS acima de ELASTICO_MAX (consumidores no máximo do grupo elástico)"
+#endif
+#if MODO_PROCESSOS && ELASTICO
+#error "ELASTICO cria Threads consumidoras, incompatível com MODO_PROCESSOS"
+#endif
+
+/* Produto no vetor, 'envio' é o instante pretendido de envio (agenda da carga aberta) */
+typedef struct
+{
+    size_t valor;
+    uint64_t envio;
+#if TAM_MENSAGEM
+    unsigned char *mensagem; /* Bloco do pool do produtor (somente o ponteiro passa pela fila) */
+    size_t tam;
+#endif
+} produto_t;
+
+/* Estado compartilhado entre produtores e consumidores (memória do processo ou segmento shm) */
+typedef struct
+{
+    pthread_mutex_t mutex_m;    /* Sessão critica acesso ao vetor 'produtos' e variáveis de índices */
+    semaforo_t prod_s, cons_s;  /* Semáforo para controlar a produção e consumo */
 
-pthread_mutex_t mutex_m;    /* Sessão critica acesso ao vetor 'produtos' e variáveis de índices */
-sem_t prod_s, cons_s;       /* Semáforo para controlar a produção e consumo */
+    produto_t produtos[MAX_PROD]; /* Vetor de produção (sessão critica) */
+    anel_lote_t anel;           /* Índices e ocupados do vetor 'produtos' (sessão critica) */
 
-size_t produtos[MAX_PROD];  /* Vetor de produção (sessão critica) */
-size_t len_cons = 0;        /* Índice de consumo no vetor 'produtos' (sessão critica) */
-size_t len_prod = 0;        /* Índice de produção no vetor 'produtos' (sessão critica) */
+    size_t fim_flag;            /* Flag para encerrar consumidores (fim de todo consumo e fim dos produtores) */
 
-size_t fim_flag = 0;        /* Flag para encerrar consumidores (fim de todo consumo e fim dos produtores) */
+    latencia_t latencias[NUM_CONS]; /* Latência do envio ao consumo, uma por consumidor (sem trava) */
+    size_t produzidos[NUM_PROD];    /* Progresso de cada produtor (retomado ao reiniciar o processo) */
+} fila_t;
 
+fila_t fila_local;          /* Modo Threads, tudo na memória do próprio processo */
+fila_t *fila = &fila_local; /* Modo processos, aponta para o segmento mapeado */
 
-void *produtor(void *num_thread)
+#if ELASTICO
+elastico_t elastico; /* Consumidores criados e encerrados pelo controlador de 'elastico.h' */
+#define consumidor_aposenta() elastico_aposenta(&elastico)
+#else
+#define consumidor_aposenta() 0
+#endif
+
+/* Inicializa a mutex e os semáforos (compartilhados entre processos no MODO_PROCESSOS) */
+void fila_inicia(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+#if MODO_PROCESSOS
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    /* Processo que morrer com a mutex não trava os outros para sempre */
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+    pthread_mutex_init(&fila->mutex_m, &attr);
+    pthread_mutexattr_destroy(&attr);
+    anel_lote_inicia(&fila->anel, MAX_PROD);
+
+    /* Contagem de slots no modo de um produto por vez, aviso único ("existe espaço") nos lotes */
+    semaforo_init(&fila->prod_s, MODO_PROCESSOS, TAM_LOTE == 1 && !MODO_PROCESSOS ? MAX_PROD : 1);
+    semaforo_init(&fila->cons_s, MODO_PROCESSOS, 0);
+}
+
+#if MODO_PROCESSOS
+/*
+    O dono da mutex morreu dentro da sessão critica, o lote pode ter ficado
+    pela metade: 'ocupados' é refeito a partir dos índices (com os índices
+    iguais vale vazio ou cheio, o mais próximo do valor antigo).
+*/
+void recupera_fila(void)
+{
+    anel_lote_t *a = &fila->anel;
+    size_t ocupados = (a->len_prod + MAX_PROD - a->len_cons) % MAX_PROD;
+    if (!ocupados && a->ocupados > MAX_PROD / 2)
+        ocupados = MAX_PROD;
+    printf("Mutex recuperada de processo encerrado, ocupados %02zu -> %02zu\n", a->ocupados, ocupados);
+    fflush(stdout);
+    a->ocupados = ocupados;
+}
+#endif
+
+/* Entra na sessão critica, no MODO_PROCESSOS recupera a mutex de um processo que morreu com ela */
+void trava_fila(void)
+{
+#if MODO_PROCESSOS
+    if (pthread_mutex_lock(&fila->mutex_m) == EOWNERDEAD)
+    {
+        recupera_fila();
+        pthread_mutex_consistent(&fila->mutex_m);
+    }
+#else
+    pthread_mutex_lock(&fila->mutex_m);
+#endif
+}
+
+#if TAM_MENSAGEM
+pool_t pools[NUM_PROD]; /* Um pool de mensagens por produtor (existem até o fim dos consumidores) */
+
+/* Sorteia o tamanho e escreve a mensagem no bloco do pool do produtor (sem cópia na fila) */
+void mensagem_cria(produto_t *produto, pool_t *pool, carga_t *carga)
+{
+    produto->tam = carga_intervalo(carga, TAM_MENSAGEM) + 1;
+    if (!(produto->mensagem = pool_aloca(pool, produto->tam)))
+    {
+        perror("mensagem: pool_aloca");
+        abort();
+    }
+    memset(produto->mensagem, (int)produto->valor, produto->tam);
+}
+
+/* Lê a mensagem no próprio bloco e o devolve ao pool dono, retorna 0 caso esteja corrompida */
+int mensagem_consome(produto_t *produto)
+{
+    size_t i, soma = 0;
+    for (i = 0; i < produto->tam; i++)
+        soma += produto->mensagem[i];
+    pool_libera(NULL, produto->mensagem);
+    return soma == produto->valor * produto->tam;
+}
+#endif
+
+
+/*
+    API de lote (produção): insere até 'n' valores em slots contíguos do vetor em
+    uma única sessão critica. Retorna quantos valores foram inseridos (pode ser
+    menor que 'n' caso falte espaço) e grava o slot de cada valor em 'posicoes'.
+
+    Com TAM_LOTE > 1 os semáforos são os avisos de lote de 'anel_lote.h', a
+    contagem real fica em 'ocupados' do anel. MODO_PROCESSOS sempre usa
+    avisos: um aviso perdido por um processo que morreu é reposto pela main,
+    o excedente é descartado por quem o encontrar sem espaço/produto.
+*/
+size_t insere_lote(const produto_t *valores, size_t *posicoes, size_t n)
 {
-    /* Semente aleatória para essa Thread (horas mais múltiplos de 60) */
-    srand((size_t)time(NULL) + (*(size_t *)num_thread + 1) * 60);
-    size_t prod_cont = 0;
+#if TAM_LOTE == 1 && !MODO_PROCESSOS
+    size_t slot;
+    int avisos;
+    (void)n;
+    /* Vetor cheio aguardando por pelo menos um consumidor */
+    semaforo_wait(&fila->prod_s);
+
+    /* Sessão critica (Exclusão Mútua)*/
+    trava_fila();
+
+    /* O semáforo conta slots, os avisos do anel não são usados */
+    anel_lote_insere(&fila->anel, 1, &slot, &avisos);
+    fila->produtos[slot] = valores[0];
+    posicoes[0] = slot;
+
+    /* Produção inserida (libera pelo menos um consumidor) */
+    semaforo_post(&fila->cons_s);
+
+    /* Fim da sessão critica (Exclusão Mútua)*/
+    pthread_mutex_unlock(&fila->mutex_m);
+    return 1;
+#else
+    size_t i, slot;
+    int avisos;
     while (1)
     {
-        sleep((rand() % 3 + 1) * 100);
+        /* Aguarda aviso de espaço livre */
+        semaforo_wait(&fila->prod_s);
+
+        /* Sessão critica (Exclusão Mútua)*/
+        trava_fila();
+        if (anel_lote_livres(&fila->anel))
+            break;
+        /* Aviso excedente (reposto pela main), descartado */
+        pthread_mutex_unlock(&fila->mutex_m);
+    }
+
+    /* Reserva os slots livres do lote */
+    n = anel_lote_insere(&fila->anel, n, &slot, &avisos);
+    for (i = 0; i < n; i++)
+    {
+        posicoes[i] = anel_lote_slot(&fila->anel, slot, i);
+        fila->produtos[posicoes[i]] = valores[i];
+    }
 
-        /* Vetor cheio aguardando por pelo menos um consumidor */
-        sem_wait(&prod_s);
+    /* Fim da sessão critica (Exclusão Mútua)*/
+    pthread_mutex_unlock(&fila->mutex_m);
+
+    /* Ainda sobrou espaço, repassa o aviso para outro produtor (cheio, o aviso volta pelo consumidor) */
+    if (avisos & ANEL_REPASSA)
+        semaforo_post(&fila->prod_s);
+    /* Vetor deixou de estar vazio, cria o aviso de produto (um único para o lote inteiro) */
+    if (avisos & ANEL_CRIA)
+        semaforo_post(&fila->cons_s);
+    return n;
+#endif
+}
+
+#if ELASTICO
+/* Produtos no vetor (leitura para o controlador do grupo elástico) */
+size_t fila_ocupacao(void)
+{
+    size_t ocupados;
+    trava_fila();
+    ocupados = fila->anel.ocupados;
+    pthread_mutex_unlock(&fila->mutex_m);
+    return ocupados;
+}
+
+/* Aviso extra em 'cons_s', acorda um consumidor para atender o pedido de encerramento */
+void acorda_consumidor(void)
+{
+    semaforo_post(&fila->cons_s);
+}
+#endif
+
+/*
+    API de lote (consumo): remove até 'max' valores em uma única sessão critica.
+    Retorna quantos valores foram removidos ou 0 caso o vetor esteja vazio e a
+    produção tenha encerrado ('fim_flag').
+*/
+size_t remove_lote(produto_t *valores, size_t *posicoes, size_t max)
+{
+#if TAM_LOTE == 1 && !MODO_PROCESSOS
+    size_t slot;
+    int avisos;
+    (void)max;
+    /* Vetor vazio aguardando por pelo menos um produtor */
+    semaforo_wait(&fila->cons_s);
+
+    /* Sessão critica (Exclusão Mútua)*/
+    trava_fila();
+
+    /* Vetor vazio ('len_cons == len_prod' também vale com o vetor cheio) */
+    while (!fila->anel.ocupados)
+    {
+        /* Verifica encerramento dos produtores (ou pedido de encerramento do grupo elástico) */
+        if (fila->fim_flag || consumidor_aposenta())
+        {
+            pthread_mutex_unlock(&fila->mutex_m);
+            return 0;
+        }
+        /* Aviso extra do controlador elástico, o pedido já foi atendido por outro consumidor */
+        pthread_mutex_unlock(&fila->mutex_m);
+        semaforo_wait(&fila->cons_s);
+        trava_fila();
+    }
+
+    /* O semáforo conta slots, os avisos do anel não são usados */
+    anel_lote_remove(&fila->anel, 1, 0, &slot, &avisos);
+    valores[0] = fila->produtos[slot];
+    posicoes[0] = slot;
+
+    /* Fim sessão critica (Exclusão Mútua)*/
+    pthread_mutex_unlock(&fila->mutex_m);
+
+    /* Consumido (libera um produtor caso esses já tenham enchido o vetor) */
+    semaforo_post(&fila->prod_s);
+    return 1;
+#else
+    size_t i, n, slot;
+    int avisos;
+    while (1)
+    {
+        /* Aguarda aviso de produto */
+        semaforo_wait(&fila->cons_s);
 
         /* Sessão critica (Exclusão Mútua)*/
-        pthread_mutex_lock(&mutex_m);
+        trava_fila();
+        if (fila->anel.ocupados)
+            break;
+        /* Vetor vazio e produtores encerrados, repassa o aviso de fim ao próximo consumidor */
+        if (fila->fim_flag)
+        {
+            pthread_mutex_unlock(&fila->mutex_m);
+            semaforo_post(&fila->cons_s);
+            return 0;
+        }
+        /* Pedido de encerramento do grupo elástico (o aviso era para esse consumidor) */
+        if (consumidor_aposenta())
+        {
+            pthread_mutex_unlock(&fila->mutex_m);
+            return 0;
+        }
+        /* Aviso excedente (reposto pela main ou do controlador elástico), descartado */
+        pthread_mutex_unlock(&fila->mutex_m);
+    }
 
-        /* Inserindo um valor aleatório entre 1 e 99 (simulando a produção) */
-        produtos[len_prod] = rand() % 99 + 1;
-        prod_cont++;
-        printf("Produzindo: %02d, Pos: %02d, Thread: %02ld (%02d/%02d)\n", produtos[len_prod],
-               len_prod + 1, *(size_t *)num_thread + 1, prod_cont, LIMIT_PROD);
-        len_prod = (len_prod + 1) % MAX_PROD;
+    /* Drena até 'max' produtos de uma vez */
+    n = anel_lote_remove(&fila->anel, max, fila->fim_flag, &slot, &avisos);
+    for (i = 0; i < n; i++)
+    {
+        posicoes[i] = anel_lote_slot(&fila->anel, slot, i);
+        valores[i] = fila->produtos[posicoes[i]];
+    }
 
-        /* Produção inserida (libera pelo menos um consumidor) */
-        sem_post(&cons_s);
+    /* Fim sessão critica (Exclusão Mútua)*/
+    pthread_mutex_unlock(&fila->mutex_m);
 
-        /* Fim da sessão critica (Exclusão Mútua)*/
-        pthread_mutex_unlock(&mutex_m);
+    /* Sobrou produto ou a produção encerrou, o aviso segue para outro consumidor */
+    if (avisos & ANEL_REPASSA)
+        semaforo_post(&fila->cons_s);
+    /* Vetor deixou de estar cheio, cria o aviso de espaço (um único para todos os slots do lote) */
+    if (avisos & ANEL_CRIA)
+        semaforo_post(&fila->prod_s);
+    return n;
+#endif
+}
 
-        
-        /* Verifica limite de produção */
+void *produtor(void *num_thread)
+{
+    /* Gerador de carga dessa Thread (semente da execução + número da Thread) */
+    carga_t carga;
+    carga_inicia(&carga, *(size_t *)num_thread);
+    RASTREIO_THREAD("produtor", *(size_t *)num_thread + 1);
+    /* Retoma a produção já feita (processo reiniciado no MODO_PROCESSOS) */
+    size_t prod_cont = fila->produzidos[*(size_t *)num_thread], i, n, lim;
+    produto_t valores[TAM_LOTE];
+    size_t posicoes[TAM_LOTE];
+    /* Agenda da carga aberta, instante pretendido do próximo produto */
+    uint64_t periodo = carga_periodo_ns(), proximo = carga_agora_ns() + periodo, agora;
+#if TAM_MENSAGEM
+    pool_t *pool = &pools[*(size_t *)num_thread];
+#endif
+    while (1)
+    {
+        /* Verifica limite de produção (antes do lote, o processo reiniciado pode já ter terminado) */
         if (prod_cont == LIMIT_PROD)
         {
-            printf("Fim do produtor: %02ld\n", *(size_t *)num_thread + 1);
+            LOG("Fim do produtor: %02ld\n", *(size_t *)num_thread + 1);
             pthread_exit(NULL);
             return NULL; /*opcional*/
         }
+
+        /* Lote limitado pelo restante da produção dessa Thread */
+        lim = LIMIT_PROD - prod_cont;
+        if (lim > TAM_LOTE)
+            lim = TAM_LOTE;
+
+        if (periodo)
+        {
+            /* Carga aberta, aguarda o instante pretendido (não espera se estiver atrasado) */
+            carga_espera_ate_ns(proximo);
+            RASTREIO_INICIO("produz");
+            agora = carga_agora_ns();
+            /* Todos os produtos já vencidos na agenda entram no lote (o atraso não some) */
+            for (n = 0; n < lim && proximo + n * periodo <= agora; n++)
+                valores[n].envio = proximo + n * periodo;
+        }
+        else
+        {
+            /* Carga fechada, o próximo lote só é produzido após inserir o anterior, um tempo
+               de produção por item (o tamanho do lote não muda a carga oferecida) */
+            RASTREIO_INICIO("produz");
+            for (n = 0; n < lim; n++)
+            {
+                carga_servico(&carga, TEMPO_PROD);
+                valores[n].envio = carga_agora_ns();
+            }
+        }
+
+        /* Valores aleatórios entre 1 e 99 (simulando a produção) */
+        for (i = 0; i < n; i++)
+        {
+            valores[i].valor = carga_intervalo(&carga, 99) + 1;
+#if TAM_MENSAGEM
+            mensagem_cria(&valores[i], pool, &carga);
+#endif
+        }
+
+        RASTREIO_FIM("produz");
+
+        /* Insere o lote (uma sessão critica e um sinal para todo o lote) */
+        lim = n;
+        RASTREIO_INICIO("insere");
+        n = insere_lote(valores, posicoes, n);
+        RASTREIO_FIM("insere");
+#if TAM_MENSAGEM
+        /* Mensagens que não couberam voltam para o pool (liberação local) */
+        for (i = n; i < lim; i++)
+            pool_libera(pool, valores[i].mensagem);
+#endif
+        /* Avança a agenda somente pelo que foi inserido, o resto mantém o instante pretendido */
+        proximo += n * periodo;
+
+        for (i = 0; i < n; i++)
+        {
+            prod_cont++;
+            LOG("Produzindo: %02ld, Pos: %02ld, Thread: %02ld (%02ld/%02ld)\n", valores[i].valor,
+                   posicoes[i] + 1, *(size_t *)num_thread + 1, prod_cont, LIMIT_PROD);
+        }
+        fila->produzidos[*(size_t *)num_thread] = prod_cont;
     }
 }
 
 void *consumidor(void *num_thread)
 {
-    /* Semente aleatória para essa Thread (horas menos múltiplos de 60) */
-    srand((size_t)time(NULL) - (*(size_t *)num_thread + 1) * 60);
-    size_t cons_cont = 0;
+    /* Gerador de carga dessa Thread (fluxos após os dos produtores) */
+    carga_t carga;
+    carga_inicia(&carga, NUM_PROD + *(size_t *)num_thread);
+    RASTREIO_THREAD("consumidor", *(size_t *)num_thread + 1);
+    size_t cons_cont = 0, i, n;
+    /* Produtos do último lote, o consumo de cada um é simulado antes de drenar o próximo */
+    size_t ultimo_lote = 1;
+    produto_t valores[TAM_LOTE];
+    size_t posicoes[TAM_LOTE];
+    uint64_t agora;
+    latencia_t *lat = &fila->latencias[*(size_t *)num_thread];
     while (1)
     {
-        sleep((rand() % 4 + 2) * 100);
-
-        /* Vetor cheio aguardando por pelo menos um consumidor */
-        sem_wait(&cons_s);
+        RASTREIO_INICIO("consome");
+        for (i = 0; i < ultimo_lote; i++)
+            carga_servico(&carga, TEMPO_CONS);
+        RASTREIO_FIM("consome");
+
+        /* Drena até 'TAM_LOTE' produtos (uma sessão critica e um sinal para todo o lote) */
+        RASTREIO_INICIO("remove");
+#if ELASTICO
+        elastico_ocioso(&elastico, 1);
+        n = remove_lote(valores, posicoes, TAM_LOTE);
+        elastico_ocioso(&elastico, -1);
+#else
+        n = remove_lote(valores, posicoes, TAM_LOTE);
+#endif
+        RASTREIO_FIM("remove");
 
-        /* Sessão critica (Exclusão Mútua)*/
-        pthread_mutex_lock(&mutex_m);
+        /* Fila vazia e produtores encerrados (ou consumidor dispensado pelo grupo elástico) */
+        if (n == 0)
+        {
+#if ELASTICO
+            if (elastico_aposentado)
+                LOG("Consumidor aposentado: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
+            else
+                LOG("Fim do consumidor: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
+            elastico_sai(&elastico, *(size_t *)num_thread);
+#else
+            LOG("Fim do consumidor: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
+#endif
+            pthread_exit(NULL);
+            return NULL; /*opcional*/
+        }
+        ultimo_lote = n;
 
-        /* Vetor vazio aguardando por pelo menos um produtor */
-        if (len_cons == len_prod)
+        /* Latência desde o instante pretendido de envio (inclui o tempo travado na fila cheia) */
+        agora = carga_agora_ns();
+        for (i = 0; i < n; i++)
         {
-            /* Verifica encerramento dos produtores */
-            if (fim_flag)
-            {
-                pthread_mutex_unlock(&mutex_m);
-                printf("Fim do consumidor: %02ld (%02ld)\n", *(size_t *)num_thread + 1, cons_cont);
-                pthread_exit(NULL);
-                return NULL; /*opcional*/
-            }
+            latencia_registra(lat, agora - valores[i].envio);
+#if ELASTICO
+            /* Maior espera na fila, sinal para o controlador criar consumidores */
+            elastico_registra_espera(&elastico, agora - valores[i].envio);
+#endif
         }
 
+#if TAM_MENSAGEM
+        for (i = 0; i < n; i++)
+            if (!mensagem_consome(&valores[i]))
+                LOG("Mensagem corrompida: %02ld, Thread: %02ld\n", valores[i].valor,
+                    *(size_t *)num_thread + 1);
+#endif
+
         /* Consumindo (simulando o consumo) */
-        cons_cont++;
-        printf("Consumindo: %02d, pos: %02d, Thread: %02ld (%02ld)\n", produtos[len_cons],
-                len_cons + 1, *(size_t *)num_thread + 1, cons_cont);
-        len_cons = (len_cons + 1) % MAX_PROD;
+        for (i = 0; i < n; i++)
+        {
+            cons_cont++;
+            LOG("Consumindo: %02ld, pos: %02ld, Thread: %02ld (%02ld)\n", valores[i].valor,
+                    posicoes[i] + 1, *(size_t *)num_thread + 1, cons_cont);
+        }
+    }
+}
 
-        /* Fim sessão critica (Exclusão Mútua)*/
-        pthread_mutex_unlock(&mutex_m);
+#if MODO_PROCESSOS
+/* Cria (main) ou abre (processo avulso) o segmento com a fila, retorna 0 em sucesso */
+int fila_mapeia(int cria)
+{
+    int fd = shm_open(NOME_SHM, O_RDWR | (cria ? O_CREAT | O_EXCL : 0), 0600);
+    if (fd < 0)
+        return -1;
+    if (cria && ftruncate(fd, sizeof(fila_t)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    fila = mmap(NULL, sizeof(fila_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return fila == MAP_FAILED ? -1 : 0;
+}
+
+/* Executa o papel em uma Thread do próprio processo (mesmas funções do modo Threads) */
+void processo_executa(int papel, size_t num)
+{
+    pthread_t t;
+    pthread_attr_t atributos;
+    log_inicia();
+    pthread_create(&t, afinidade_attr(&atributos, papel == PAPEL_PRODUTOR ? AFINIDADE_PRODUTOR : AFINIDADE_CONSUMIDOR, num),
+                   papel == PAPEL_PRODUTOR ? produtor : consumidor, &num);
+    pthread_attr_destroy(&atributos);
+    pthread_join(t, NULL);
+    log_finaliza();
+#if PERFIL_LOCKS
+    /* Contadores na memória do processo, relatório próprio (o _exit não esvazia o stdout) */
+    printf("\nProcesso %d - ", (int)getpid());
+    perfil_relatorio();
+    fflush(stdout);
+#endif
+#if RASTREIO
+    /* Vetores de eventos na memória do processo, um arquivo para cada */
+    char arquivo[64];
+    snprintf(arquivo, sizeof(arquivo), "rastreio.%d.json", (int)getpid());
+    rastreio_exporta_arquivo(arquivo);
+#endif
+}
 
-        /* Consumido (libera um produtor caso esses já tenham enchido o vetor) */
-        sem_post(&prod_s);
+/* Cria o processo de um produtor ou consumidor, retorna o pid */
+pid_t processo_cria(int papel, size_t num)
+{
+    pid_t pid;
+    /* O filho não repete a saída pendente da main */
+    fflush(stdout);
+    if ((pid = fork()) == 0)
+    {
+        processo_executa(papel, num);
+        _exit(0);
     }
+    return pid;
 }
 
+/*
+    Aguarda um processo encerrar. Encerrado por sinal (falha ou kill) é criado
+    de novo no mesmo papel e os avisos dos semáforos são repostos (o que morreu
+    pode ter levado um), retorna 0. Encerrado normalmente retorna o papel.
+*/
+int aguarda_processo(pid_t *prodP, pid_t *consP)
+{
+    int status, papel = PAPEL_PRODUTOR;
+    size_t i, num = NUM_PROD;
+    pid_t pid, *pids = prodP;
+
+    /* Interrompido por sinal tenta de novo, qualquer outro erro (ECHILD) é fatal */
+    while ((pid = wait(&status)) < 0)
+    {
+        if (errno != EINTR)
+        {
+            perror("wait");
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < NUM_PROD; i++)
+        if (prodP[i] == pid)
+            num = i;
+    if (num == NUM_PROD)
+    {
+        papel = PAPEL_CONSUMIDOR;
+        pids = consP;
+        num = NUM_CONS;
+        for (i = 0; i < NUM_CONS; i++)
+            if (consP[i] == pid)
+                num = i;
+        /* Filho desconhecido (nenhum papel), não conta nem reinicia */
+        if (num == NUM_CONS)
+            return 0;
+    }
+
+    if (!WIFSIGNALED(status))
+        return papel;
+
+    printf("Processo %d (%s %02zu) encerrado pelo sinal %d, reiniciando\n", (int)pid,
+           papel == PAPEL_PRODUTOR ? "produtor" : "consumidor", num + 1, WTERMSIG(status));
+    pids[num] = processo_cria(papel, num);
+    semaforo_post(&fila->prod_s);
+    semaforo_post(&fila->cons_s);
+    return 0;
+}
+#endif
+
 int main(int argc, char const *argv[])
 {
     /* Variável para iterações com FOR */
     size_t i;
+#if MODO_PROCESSOS
+    /* Processos da produção e consumidores */
+    pid_t prodP[NUM_PROD], consP[NUM_CONS];
+    size_t prod_vivos = NUM_PROD, cons_vivos = NUM_CONS;
+    int papel;
+#else
     /* Threads da produção e consumidores */
-    pthread_t prodT[NUM_PROD], consT[NUM_CONS];
+    pthread_t prodT[NUM_PROD];
+    /* Atributos de afinidade de cada criação */
+    pthread_attr_t atributos;
 
     /* Enumera cada Thread produtora pra contar produção de cada */
-    size_t num_prod_thread[NUM_PROD], num_cons_thread[NUM_CONS];
+    size_t num_prod_thread[NUM_PROD];
+#if !ELASTICO
+    /* Consumidores fixos (no grupo elástico ficam em 'elastico') */
+    pthread_t consT[NUM_CONS];
+    size_t num_cons_thread[NUM_CONS];
+#endif
+#endif
 
-    /* Inicialização da Mutex e Semáforos */
-    pthread_mutex_init(&mutex_m, NULL);
+    /* Semente e distribuição da carga (variáveis CARGA_* de ambiente) */
+    carga_configura();
+    /* Posicionamento das Threads (variável AFINIDADE), papéis na ordem de criação */
+    if (afinidade_configura(NULL) < 0)
+    {
+        fprintf(stderr, "AFINIDADE invalida: '%s'\n", getenv("AFINIDADE"));
+        return 1;
+    }
+    afinidade_papel(AFINIDADE_CONSUMIDOR, NUM_CONS);
+    afinidade_papel(AFINIDADE_PRODUTOR, NUM_PROD);
+
+#if MODO_PROCESSOS
+    /* Processo avulso ('produtor N' ou 'consumidor N'), entra na fila já criada */
+    if (argc == 3)
+    {
+        char *fim;
+        unsigned long num = strtoul(argv[2], &fim, 10);
+        /* Papel conhecido e número dentro dos vetores do segmento (1 a NUM_PROD ou NUM_CONS) */
+        papel = !strcmp(argv[1], "produtor") ? PAPEL_PRODUTOR : !strcmp(argv[1], "consumidor") ? PAPEL_CONSUMIDOR : 0;
+        if (!papel || fim == argv[2] || *fim || num < 1 ||
+            num > (papel == PAPEL_PRODUTOR ? NUM_PROD : NUM_CONS))
+        {
+            fprintf(stderr, "Uso: %s produtor 1..%d | consumidor 1..%d\n", argv[0], NUM_PROD, NUM_CONS);
+            return 1;
+        }
+        if (fila_mapeia(0) < 0)
+        {
+            perror("shm_open " NOME_SHM);
+            return 1;
+        }
+        processo_executa(papel, num - 1);
+        return 0;
+    }
+
+    /* Segmento novo (descarta o de uma execução anterior interrompida) */
+    shm_unlink(NOME_SHM);
+    if (fila_mapeia(1) < 0)
+    {
+        perror("shm_open " NOME_SHM);
+        return 1;
+    }
+#else
+    /* Argumentos somente para processos avulsos */
+    (void)argc;
+    (void)argv;
+#endif
 
-    sem_init(&prod_s, 0, MAX_PROD);
-    sem_init(&cons_s, 0, 0);
+    /* Inicialização da Mutex e Semáforos */
+    fila_inicia();
+    /* Fila no nó NUMA das Threads (move as páginas já tocadas na inicialização) */
+    afinidade_memoria(fila, sizeof(fila_t));
 
+#if TAM_MENSAGEM
+    for (i = 0; i < NUM_PROD; i++)
+        pool_inicia(&pools[i]);
+#endif
+    printf("Semente: %llu, distribuicao: %s\n", (unsigned long long)carga_semente,
+           carga_nome_distribuicao());
+    afinidade_relatorio();
+    if (carga_taxa > 0)
+        printf("Carga aberta: %.1f produtos/s por produtor\n", carga_taxa);
+    else
+        printf("Carga fechada\n");
 
     printf("Inicia...\n\n");
 
+#if MODO_PROCESSOS
+    /* Um processo por produtor e consumidor (cada um com seu próprio log) */
+    for (i = 0; i < NUM_CONS; i++)
+        consP[i] = processo_cria(PAPEL_CONSUMIDOR, i);
+    for (i = 0; i < NUM_PROD; i++)
+        prodP[i] = processo_cria(PAPEL_PRODUTOR, i);
+
+    /* Aguarda fim dos processos produtores (reiniciando os que morrerem) */
+    while (prod_vivos)
+    {
+        papel = aguarda_processo(prodP, consP);
+        prod_vivos -= papel == PAPEL_PRODUTOR;
+        cons_vivos -= papel == PAPEL_CONSUMIDOR;
+    }
+#else
+    /* Escritor de fundo do log (antes das Threads) */
+    log_inicia();
+
     /* Inicialização das Threads (inicia condições de corrida) */
+#if ELASTICO
+    /* Somente MIN_CONS consumidores, o controlador cria os demais conforme a fila */
+    elastico_inicia(&elastico, MIN_CONS, NUM_CONS, consumidor, fila_ocupacao, acorda_consumidor);
+#else
     for (i = 0; i < NUM_CONS; i++)
     {
         num_cons_thread[i] = i;
-        pthread_create((consT + i), NULL, (void *)&consumidor, (void *)(num_cons_thread + i));
+        pthread_create((consT + i), afinidade_attr(&atributos, AFINIDADE_CONSUMIDOR, i),
+                       (void *)&consumidor, (void *)(num_cons_thread + i));
+        pthread_attr_destroy(&atributos);
     }
+#endif
     for (i = 0; i < NUM_PROD; i++)
     {
         num_prod_thread[i] = i;
-        pthread_create((prodT + i), NULL, (void *)&produtor, (void *)(num_prod_thread + i));
+        pthread_create((prodT + i), afinidade_attr(&atributos, AFINIDADE_PRODUTOR, i),
+                       (void *)&produtor, (void *)(num_prod_thread + i));
+        pthread_attr_destroy(&atributos);
     }
 
     /* Aguarda fim das Threads produtoras */
     for (i = 0; i < NUM_PROD; i++)
         pthread_join(prodT[i], NULL);
+#if ELASTICO
+    /* Encerra o controlador, os consumidores existentes drenam o restante */
+    elastico_para(&elastico);
+#endif
+#endif
 
 
     /* Livra possíveis Thread consumidoras do bloqueio de falta de produtos, necessário para finalizarem */
-    pthread_mutex_lock(&mutex_m);
+    trava_fila();
      /* Sinaliza fim da produção para consumidores */
-    fim_flag = 1;
+    fila->fim_flag = 1;
     /* Caso alguma não tenha chegado ainda no wait, ela irá finalizar antes no if do fim_flag, não travando mais no wait */
-    pthread_mutex_unlock(&mutex_m);
+    pthread_mutex_unlock(&fila->mutex_m);
 
     /* Possibilita que todas as threads consumidoras possam saírem e finalizar
     
@@ -183,18 +908,67 @@ int main(int argc, char const *argv[])
         tenha preempção e consumidores ficam presos.
     */
     for (i = 0; i < NUM_CONS; i++)
-        sem_post(&cons_s);
+        semaforo_post(&fila->cons_s);
 
+#if MODO_PROCESSOS
+    /* Aguarda fim dos processos consumidores */
+    while (cons_vivos)
+        cons_vivos -= aguarda_processo(prodP, consP) == PAPEL_CONSUMIDOR;
+#else
     /* Aguarda fim das Threads consumidoras */
+#if ELASTICO
+    elastico_aguarda(&elastico);
+#else
     for (i = 0; i < NUM_CONS; i++)
     {
         pthread_join(consT[i], NULL);
     }
+#endif
+    /* Escreve o restante do log (Threads já encerradas) */
+    log_finaliza();
+#endif
+
     printf("\nFim\n");
 
-    pthread_mutex_destroy(&mutex_m);
-    sem_destroy(&prod_s);
-    sem_destroy(&cons_s);
+    /* Latência de todos os consumidores (envio pretendido até o consumo) */
+    for (i = 1; i < NUM_CONS; i++)
+        latencia_junta(&fila->latencias[0], &fila->latencias[i]);
+    latencia_relatorio(&fila->latencias[0], "envio-consumo");
+#if !MODO_PROCESSOS
+    perfil_relatorio();
+#endif
+    RASTREIO_EXPORTA();
+#if ELASTICO
+    elastico_relatorio(&elastico);
+#endif
+#if TAREFAS
+    tarefas_relatorio();
+#endif
+
+#if TAM_MENSAGEM
+    /* Pools já sem blocos em uso (todos os consumidores encerraram) */
+    for (i = 0; i < NUM_PROD; i++)
+    {
+        char nome[16];
+        snprintf(nome, sizeof(nome), "produtor %02zu", i + 1);
+        pool_relatorio(&pools[i], nome);
+        pool_destroi(&pools[i]);
+    }
+#endif
+
+#if USA_FUTEX
+    /* Esperas atendidas em espaço de usuário (giro) e as que precisaram do kernel */
+    futex_sem_relatorio(&fila->prod_s, "prod_s");
+    futex_sem_relatorio(&fila->cons_s, "cons_s");
+#endif
+
+    pthread_mutex_destroy(&fila->mutex_m);
+    semaforo_destroy(&fila->prod_s);
+    semaforo_destroy(&fila->cons_s);
+#if MODO_PROCESSOS
+    munmap(fila, sizeof(fila_t));
+    shm_unlink(NOME_SHM);
+#endif
 
     return 0;
 }
@@ -0,0 +1,269 @@
+/****************************************************************************
+ * Grupo elástico de consumidores para os programas de produtor e           *
+ *  consumidor, em vez de NUM_CONS Threads fixas (a maioria parada na       *
+ *  condicional, acordando à toa a cada sinal).                             *
+ *                                                                          *
+ * Uma Thread controladora observa a cada ELASTICO_INTERVALO_NS a ocupação  *
+ *  do vetor, quantos consumidores estão ociosos (esperando produto) e a    *
+ *  maior espera de produto na fila desde a última observação:              *
+ *  - fila com produto (ou espera acima de ELASTICO_ESPERA_ALVO_NS) e       *
+ *    nenhum consumidor ocioso: cria um consumidor (até 'max');             *
+ *  - consumidores ociosos por ELASTICO_RESFRIAMENTO_NS seguidos: pede a    *
+ *    um consumidor ocioso que encerre (até 'min').                         *
+ *  Cada ajuste é registrado no log e os totais no relatório final.         *
+ *                                                                          *
+ * O programa informa como ler a ocupação e como acordar um consumidor      *
+ *  ocioso, o consumidor chama elastico_aposenta() junto do teste de fim    *
+ *  da produção e elastico_sai() antes de encerrar a Thread.                *
+ *************************************************************************** */
+
+#ifndef ELASTICO_H
+#define ELASTICO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "log_assincrono.h"
+#include "afinidade.h"
+
+/* Consumidores no máximo (vetor de Threads do grupo) */
+#define ELASTICO_MAX            64
+/* Intervalo entre observações do controlador */
+#define ELASTICO_INTERVALO_NS   20000000ull
+/* Espera de produto na fila que já pede mais consumidores */
+#define ELASTICO_ESPERA_ALVO_NS 100000000ull
+/* Tempo com consumidores ociosos antes de encerrar um deles */
+#define ELASTICO_RESFRIAMENTO_NS 300000000ull
+
+/* Estado de cada posição do grupo */
+#define ELASTICO_LIVRE      0
+#define ELASTICO_ATIVO      1
+#define ELASTICO_ENCERRADO  2 /* Thread terminou, aguardando o join do controlador */
+
+typedef struct
+{
+    size_t min, max;
+    void *(*consumidor)(void *);   /* Função da Thread, recebe ponteiro para o número */
+    size_t (*ocupacao)(void);      /* Produtos no vetor */
+    void (*acorda)(void);          /* Acorda um consumidor ocioso (sinal ou post) */
+
+    pthread_t threads[ELASTICO_MAX];
+    size_t numeros[ELASTICO_MAX];
+    atomic_int estado[ELASTICO_MAX];
+
+    pthread_t controlador;
+    atomic_int executando;
+    atomic_size_t ativos;          /* Consumidores criados e ainda não aposentados */
+    atomic_size_t ociosos;         /* Consumidores esperando produto */
+    atomic_size_t aposentar;       /* Pedidos de encerramento pendentes */
+    _Atomic uint64_t espera_max;   /* Maior espera na fila desde a última observação */
+    atomic_size_t aposentados;
+
+    /* Totais (escritos somente pelo controlador) */
+    size_t criados, pico;
+    uint64_t inicio, consumidor_ns, ultima;  /* Integral de 'ativos' no tempo */
+} elastico_t;
+
+static _Thread_local int elastico_aposentado = 0; /* Consumidor atual encerrou por pedido */
+
+
+static inline uint64_t elastico_agora(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/* Cria um consumidor em uma posição livre, retorna 0 caso o grupo esteja cheio */
+static inline int elastico_cria(elastico_t *e)
+{
+    size_t i;
+    pthread_attr_t atributos;
+    for (i = 0; i < e->max; i++)
+    {
+        if (atomic_load(&e->estado[i]) != ELASTICO_LIVRE)
+            continue;
+        atomic_store(&e->estado[i], ELASTICO_ATIVO);
+        e->numeros[i] = i;
+        atomic_fetch_add(&e->ativos, 1);
+        /* Consumidor 'i' na CPU da política de posicionamento (mesma da Thread fixa 'i') */
+        pthread_create(&e->threads[i], afinidade_attr(&atributos, AFINIDADE_CONSUMIDOR, i), e->consumidor, &e->numeros[i]);
+        pthread_attr_destroy(&atributos);
+        e->criados++;
+        if (atomic_load(&e->ativos) > e->pico)
+            e->pico = atomic_load(&e->ativos);
+        return 1;
+    }
+    return 0;
+}
+
+/* Join das Threads já encerradas, libera as posições */
+static inline void elastico_recolhe(elastico_t *e)
+{
+    size_t i;
+    for (i = 0; i < e->max; i++)
+    {
+        if (atomic_load(&e->estado[i]) == ELASTICO_ENCERRADO)
+        {
+            pthread_join(e->threads[i], NULL);
+            atomic_store(&e->estado[i], ELASTICO_LIVRE);
+        }
+    }
+}
+
+static void *elastico_controle(void *arg)
+{
+    elastico_t *e = (elastico_t *)arg;
+    struct timespec intervalo = {0, ELASTICO_INTERVALO_NS};
+    uint64_t agora, espera, ocioso_desde = 0;
+    size_t ocupacao, ociosos, ativos;
+
+    while (atomic_load(&e->executando))
+    {
+        nanosleep(&intervalo, NULL);
+        elastico_recolhe(e);
+
+        agora = elastico_agora();
+        ocupacao = e->ocupacao();
+        ociosos = atomic_load(&e->ociosos);
+        ativos = atomic_load(&e->ativos);
+        espera = atomic_exchange(&e->espera_max, 0);
+        e->consumidor_ns += ativos * (agora - e->ultima);
+        e->ultima = agora;
+
+        if (!ociosos && ativos < e->max && (ocupacao || espera > ELASTICO_ESPERA_ALVO_NS))
+        {
+            /* Produto esperando e ninguém livre para pegar */
+            if (elastico_cria(e))
+                LOG("Controle: +1 consumidor (ativos %02ld, ocupacao %02ld, espera %ld us)\n",
+                    ativos + 1, ocupacao, espera / 1000);
+            ocioso_desde = 0;
+        }
+        else if (ociosos && !ocupacao)
+        {
+            /* Sobra consumidor, encerra um por resfriamento (até o mínimo) */
+            if (!ocioso_desde)
+                ocioso_desde = agora;
+            else if (agora - ocioso_desde >= ELASTICO_RESFRIAMENTO_NS && ativos > e->min &&
+                     !atomic_load(&e->aposentar))
+            {
+                atomic_fetch_add(&e->aposentar, 1);
+                e->acorda();
+                LOG("Controle: -1 consumidor (ativos %02ld, ociosos %02ld)\n", ativos - 1, ociosos);
+                ocioso_desde = agora;
+            }
+        }
+        else
+            ocioso_desde = 0;
+    }
+    return NULL;
+}
+
+/* Cria 'min' consumidores e o controlador */
+static inline void elastico_inicia(elastico_t *e, size_t min, size_t max, void *(*consumidor)(void *),
+                                   size_t (*ocupacao)(void), void (*acorda)(void))
+{
+    size_t i;
+
+    e->min = min < 1 ? 1 : min;
+    /* Os programas barram NUM_CONS > ELASTICO_MAX na compilação, o limite só protege o vetor */
+    e->max = max > ELASTICO_MAX ? ELASTICO_MAX : max;
+    e->consumidor = consumidor;
+    e->ocupacao = ocupacao;
+    e->acorda = acorda;
+    for (i = 0; i < ELASTICO_MAX; i++)
+        atomic_init(&e->estado[i], ELASTICO_LIVRE);
+    atomic_init(&e->ativos, 0);
+    atomic_init(&e->ociosos, 0);
+    atomic_init(&e->aposentar, 0);
+    atomic_init(&e->espera_max, 0);
+    atomic_init(&e->aposentados, 0);
+    e->criados = e->pico = 0;
+    e->inicio = e->ultima = elastico_agora();
+    e->consumidor_ns = 0;
+
+    for (i = 0; i < e->min; i++)
+        elastico_cria(e);
+    atomic_init(&e->executando, 1);
+    pthread_create(&e->controlador, NULL, elastico_controle, e);
+}
+
+/* Encerra o controlador (antes de sinalizar o fim da produção, nada mais é criado) */
+static inline void elastico_para(elastico_t *e)
+{
+    uint64_t agora;
+    atomic_store(&e->executando, 0);
+    pthread_join(e->controlador, NULL);
+    agora = elastico_agora();
+    e->consumidor_ns += atomic_load(&e->ativos) * (agora - e->ultima);
+    e->ultima = agora;
+}
+
+/* Aguarda todos os consumidores do grupo encerrarem */
+static inline void elastico_aguarda(elastico_t *e)
+{
+    size_t i;
+    for (i = 0; i < e->max; i++)
+    {
+        if (atomic_load(&e->estado[i]) != ELASTICO_LIVRE)
+        {
+            pthread_join(e->threads[i], NULL);
+            atomic_store(&e->estado[i], ELASTICO_LIVRE);
+        }
+    }
+}
+
+/* Consumidor entrando (+1) ou saindo (-1) da espera por produto */
+static inline void elastico_ocioso(elastico_t *e, int delta)
+{
+    if (delta > 0)
+        atomic_fetch_add_explicit(&e->ociosos, 1, memory_order_relaxed);
+    else
+        atomic_fetch_sub_explicit(&e->ociosos, 1, memory_order_relaxed);
+}
+
+/* Espera de um produto na fila (envio até o consumo), guarda a maior */
+static inline void elastico_registra_espera(elastico_t *e, uint64_t ns)
+{
+    uint64_t atual = atomic_load_explicit(&e->espera_max, memory_order_relaxed);
+    while (ns > atual && !atomic_compare_exchange_weak(&e->espera_max, &atual, ns))
+        ;
+}
+
+/* Consumidor ocioso atende um pedido de encerramento pendente, retorna 1 caso deva encerrar */
+static inline int elastico_aposenta(elastico_t *e)
+{
+    size_t p = atomic_load(&e->aposentar);
+    while (p)
+    {
+        if (atomic_compare_exchange_weak(&e->aposentar, &p, p - 1))
+        {
+            atomic_fetch_sub(&e->ativos, 1);
+            elastico_aposentado = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Última chamada do consumidor, a posição fica para o join do controlador */
+static inline void elastico_sai(elastico_t *e, size_t numero)
+{
+    if (elastico_aposentado)
+        atomic_fetch_add(&e->aposentados, 1);
+    atomic_store(&e->estado[numero], ELASTICO_ENCERRADO);
+}
+
+/* Totais do grupo: criados, aposentados, pico e média de consumidores ativos */
+static inline void elastico_relatorio(elastico_t *e)
+{
+    uint64_t total = e->ultima - e->inicio;
+    printf("Consumidores: min %zu, max %zu, criados %zu, aposentados %zu, pico %zu, media ativos %.2f\n",
+           e->min, e->max, e->criados, atomic_load(&e->aposentados), e->pico,
+           total ? (double)e->consumidor_ns / total : 0.0);
+}
+
+#endif
@@ -0,0 +1,172 @@
+/****************************************************************************
+ * Semáforo contador em espaço de usuário construído sobre futex (Linux),   *
+ *  substituto do 'sem_t' para os programas de produtor e consumidor.       *
+ *                                                                          *
+ * O 'wait' tenta primeiro decrementar sem chamada de sistema, depois gira  *
+ *  (spin) por um número limitado e adaptativo de tentativas e somente      *
+ *  então dorme no kernel (FUTEX_WAIT). O 'post' só chama o kernel          *
+ *  (FUTEX_WAKE) quando existe alguma thread dormindo.                      *
+ *                                                                          *
+ * Contadores mostram quantas esperas foram atendidas de imediato, quantas  *
+ *  girando e quantas precisaram do kernel, e quantos 'post' pularam o      *
+ *  despertar por não ter ninguém esperando.                                *
+ *                                                                          *
+ * ** Somente Linux (syscall futex).                                        *
+ *************************************************************************** */
+
+#ifndef FUTEX_SEM_H
+#define FUTEX_SEM_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#ifndef __linux__
+#error "futex_sem.h: somente Linux"
+#endif
+
+/* Limites do giro adaptativo (iterações de pausa antes de dormir) */
+#define FUTEX_GIRO_MIN  16
+#define FUTEX_GIRO_MAX  4096
+
+/* Pausa curta para o giro (alivia o pipeline e o outro hyperthread) */
+#if defined(__x86_64__) || defined(__i386__)
+#define futex_pausa() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define futex_pausa() __asm__ __volatile__("yield")
+#else
+#define futex_pausa() atomic_signal_fence(memory_order_seq_cst)
+#endif
+
+typedef struct
+{
+    atomic_int valor;      /* Unidades disponíveis (palavra do futex) */
+    atomic_int esperando;  /* Threads dormindo (ou prestes a dormir) no futex */
+    atomic_int giro_max;   /* Limite atual do giro, ajustado a cada espera */
+    int privado;           /* FUTEX_PRIVATE_FLAG quando não compartilhado entre processos */
+
+    /* Contadores (em outra linha de cache, não disputam com 'valor') */
+    _Alignas(64) atomic_ulong esperas_imediatas; /* 'wait' atendido sem girar */
+    atomic_ulong esperas_giro;                   /* 'wait' atendido girando */
+    atomic_ulong esperas_kernel;                 /* 'wait' que dormiu no kernel */
+    atomic_ulong despertares;                    /* 'post' que chamou FUTEX_WAKE */
+    atomic_ulong despertares_pulados;            /* 'post' sem ninguém esperando */
+} futex_sem_t;
+
+
+static inline long futex_chamada(atomic_int *addr, int op, int val)
+{
+    return syscall(SYS_futex, (int *)addr, op, val, NULL, NULL, 0);
+}
+
+/* Mesma assinatura do sem_init, 'pshared' != 0 permite uso entre processos */
+static inline int futex_sem_init(futex_sem_t *s, int pshared, unsigned int valor)
+{
+    atomic_init(&s->valor, (int)valor);
+    atomic_init(&s->esperando, 0);
+    /* Com um único processador girar só atrasa quem vai liberar */
+    atomic_init(&s->giro_max, sysconf(_SC_NPROCESSORS_ONLN) > 1 ? FUTEX_GIRO_MIN : 0);
+    s->privado = pshared ? 0 : FUTEX_PRIVATE_FLAG;
+    atomic_init(&s->esperas_imediatas, 0);
+    atomic_init(&s->esperas_giro, 0);
+    atomic_init(&s->esperas_kernel, 0);
+    atomic_init(&s->despertares, 0);
+    atomic_init(&s->despertares_pulados, 0);
+    return 0;
+}
+
+static inline int futex_sem_destroy(futex_sem_t *s)
+{
+    (void)s;
+    return 0;
+}
+
+/* Decrementa caso exista unidade disponível, retorna 1 em sucesso */
+static inline int futex_sem_trywait(futex_sem_t *s)
+{
+    int v = atomic_load_explicit(&s->valor, memory_order_relaxed);
+    while (v > 0)
+    {
+        if (atomic_compare_exchange_weak_explicit(&s->valor, &v, v - 1,
+                                                  memory_order_acquire, memory_order_relaxed))
+            return 1;
+    }
+    return 0;
+}
+
+static inline int futex_sem_wait(futex_sem_t *s)
+{
+    int i, giro;
+
+    /* Caminho rápido, nenhuma espera */
+    if (futex_sem_trywait(s))
+    {
+        atomic_fetch_add_explicit(&s->esperas_imediatas, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    /* Gira por tempo limitado, esperando um 'post' próximo */
+    giro = atomic_load_explicit(&s->giro_max, memory_order_relaxed);
+    for (i = 0; i < giro; i++)
+    {
+        futex_pausa();
+        if (atomic_load_explicit(&s->valor, memory_order_relaxed) > 0 && futex_sem_trywait(s))
+        {
+            /* Girar compensou, permite girar mais da próxima vez */
+            if (giro < FUTEX_GIRO_MAX)
+                atomic_store_explicit(&s->giro_max, giro * 2, memory_order_relaxed);
+            atomic_fetch_add_explicit(&s->esperas_giro, 1, memory_order_relaxed);
+            return 0;
+        }
+    }
+    /* Girar não compensou, reduz o giro da próxima vez */
+    if (giro > FUTEX_GIRO_MIN)
+        atomic_store_explicit(&s->giro_max, giro / 2, memory_order_relaxed);
+
+    /*
+        Registra a espera antes de testar de novo: o 'post' incrementa
+        'valor' e depois lê 'esperando', assim um dos dois sempre vê o outro.
+    */
+    atomic_fetch_add(&s->esperando, 1);
+    while (!futex_sem_trywait(s))
+    {
+        /* Dorme somente se 'valor' ainda for 0 (o kernel confere atomicamente) */
+        futex_chamada(&s->valor, FUTEX_WAIT | s->privado, 0);
+    }
+    atomic_fetch_sub(&s->esperando, 1);
+    atomic_fetch_add_explicit(&s->esperas_kernel, 1, memory_order_relaxed);
+    return 0;
+}
+
+/* Libera 'n' unidades de uma vez (um único despertar para o lote) */
+static inline int futex_sem_post_n(futex_sem_t *s, int n)
+{
+    atomic_fetch_add(&s->valor, n);
+    if (atomic_load(&s->esperando) > 0)
+    {
+        atomic_fetch_add_explicit(&s->despertares, 1, memory_order_relaxed);
+        futex_chamada(&s->valor, FUTEX_WAKE | s->privado, n);
+    }
+    else
+        atomic_fetch_add_explicit(&s->despertares_pulados, 1, memory_order_relaxed);
+    return 0;
+}
+
+static inline int futex_sem_post(futex_sem_t *s)
+{
+    return futex_sem_post_n(s, 1);
+}
+
+/* Imprime os contadores do semáforo */
+static inline void futex_sem_relatorio(futex_sem_t *s, const char *nome)
+{
+    printf("Semaforo %s: imediatas %lu, giro %lu, kernel %lu, despertares %lu, pulados %lu\n",
+           nome,
+           atomic_load(&s->esperas_imediatas), atomic_load(&s->esperas_giro),
+           atomic_load(&s->esperas_kernel), atomic_load(&s->despertares),
+           atomic_load(&s->despertares_pulados));
+}
+
+#endif
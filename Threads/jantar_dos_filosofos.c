@@ -10,32 +10,109 @@
  *  da esquerda do primeiro filosofo e o índice 1 é o hashi da direita, e assim *
  *  por diante. Após 'LIMIT_JANTAS' o filosofo encerra.                         *
  *                                                                              *
+ * Modo 'MODO_HASHI' (compilação com -DMODO_HASHI=1): cada hashi tem a própria  *
+ *  trava (uma linha de cache por hashi) em vez da mutex_m de toda a mesa, o    *
+ *  filosofo trava primeiro o hashi de menor índice e depois o outro (ordem     *
+ *  global dos recursos, sem ciclo de espera e sem deadlock), filósofos não     *
+ *  vizinhos comem em paralelo. A variável FILOSOFOS escolhe o tamanho da mesa  *
+ *  (até NUM_FILOSOFOS) e o final mostra refeições por segundo e o pico de      *
+ *  filósofos comendo ao mesmo tempo.                                           *
+ *                                                                              *
+ * Máscara de bits (-DMODO_HASHI=2): os hashis viram bits em palavras atômicas  *
+ *  de 32 bits ('1' disponível), o filosofo pega os dois hashis com um único    *
+ *  CAS quando estão na mesma palavra; na fronteira entre palavras pega um bit  *
+ *  por vez, o de menor índice primeiro. Hashi ocupado dorme no futex da        *
+ *  palavra (Linux, sem TAREFAS) e quem devolve acorda a palavra somente se     *
+ *  alguém espera. O final mostra as tentativas falhas por refeição (par        *
+ *  ocupado ou CAS perdido; no modo 0 a volta a pensar sem o hashi da direita). *
+ *                                                                              *
+ * Gerenciador (-DMODO_HASHI=3): o filosofo é um cliente de 'recursos.h', pede  *
+ *  o conjunto {esquerda, direita} e recebe os dois sem deadlock, cada hashi    *
+ *  com a própria fila por ordem de chegada e sem trava global.                 *
+ *                                                                              *
+ * Garçom (-DMODO_HASHI=4): o filosofo pega um bilhete e aguarda na mutex_m até *
+ *  os dois hashis estarem livres e nenhum vizinho esperar com bilhete mais     *
+ *  antigo. Quem devolve os hashis acorda os dois vizinhos, filósofos sem       *
+ *  hashi em comum são liberados juntos e cada espera dura no máximo uma        *
+ *  refeição de cada vizinho.                                                   *
+ *                                                                              *
+ * Justiça (todos os modos): histograma da espera de cada filosofo (do fim do   *
+ *  pensar até comer, voltas a pensar incluídas), maior número de refeições     *
+ *  dos vizinhos durante uma espera (rodadas) e a razão entre o máximo e o      *
+ *  mínimo de refeições quando o primeiro filosofo fica satisfeito.             *
+ *                                                                              *
+ * Afinidade (variável AFINIDADE de 'afinidade.h', compacta, espalhada ou       *
+ *  listas por papel): filósofos criados na CPU da política e os hashis presos  *
+ *  no nó NUMA das Threads, posicionamento no início.                           *
+ *                                                                              *
+ * Tarefas 'TAREFAS' (compilação com -DTAREFAS=1): filósofos viram tarefas      *
+ *  M:N de 'tarefas.h' sobre poucos trabalhadores, a espera pelo hashi          *
+ *  estaciona somente a tarefa (milhares de filósofos com -DNUM_FILOSOFOS=N).   *
+ *                                                                              *
+ * ** Tempos e valores sorteados por 'carga.h' (gerador por Thread com          *
+ *    semente explícita, mesma semente reproduz a mesma carga).                 *
+ * ** Saída das Threads pelo log assíncrono de 'log_assincrono.h',              *
+ *    compilação com -DSEM_LOG remove todo o log.                               *
+ * ** Perfil das travas com -DPERFIL_LOCKS=1 ('perfil_locks.h'), relatório      *
+ *    no final ordenado pela espera total.                                      *
+ * ** Linha do tempo com -DRASTREIO=1 ('rastreio.h'): pensa, pega os hashis,    *
+ *    come e esperas por filosofo em JSON para o Perfetto ou chrome://tracing.  *
  * ** GCC incluir a biblioteca pthread através do parâmetro '-lpthread'         *
  * ** Este Programa Finaliza.                                                   *
  ******************************************************************************** */
 
+/* sched_getaffinity e pthread_attr_setaffinity_np ('afinidade.h') */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
+#include <stdatomic.h>
 #include <time.h>
 
-#ifdef _WIN32
-#include <Windows.h>
-#define sleep(ms) Sleep(ms)
-#elif __linux__
-#include <unistd.h>
-#else
-#error "OS Not Supported"
+#include "log_assincrono.h"
+#include "afinidade.h"
+
+/* Atores em Threads do sistema (0) ou em tarefas M:N de 'tarefas.h' (1) */
+#ifndef TAREFAS
+#define TAREFAS 0
+#endif
+#if TAREFAS
+/* Após o log (escritor de fundo segue Thread do sistema) e antes da carga (esperas estacionam) */
+#include "tarefas.h"
 #endif
 
+#include "carga.h"
+#include "latencia.h"
 
 /* Número de Filósofos na mesa */
+#ifndef NUM_FILOSOFOS
 #define NUM_FILOSOFOS  5
+#endif
 /* "Jantares" executadas por cada Thread antes de finalizar */
 #define LIMIT_JANTAS  10
-/* Tempo que gasta para "comer" em ms */
-#define TEMPO_COMER   70
+/* Tempo que gasta para "comer" (ns) */
+#define TEMPO_COMER   CARGA_MS(70)
+/* Tempo médio pensando (distribuição em 'carga.h') */
+#define TEMPO_PENSAR  CARGA_MS(300)
+/* Trava única da mesa (0), trava por hashi (1), máscara de bits (2), gerenciador (3) ou garçom (4) */
+#ifndef MODO_HASHI
+#define MODO_HASHI    0
+#endif
+#if MODO_HASHI == 2
+#if TAREFAS
+#error "MODO_HASHI=2 espera no futex e seguraria o trabalhador de 'tarefas.h'"
+#endif
+#include <limits.h>
+#include "futex_sem.h"
+#elif MODO_HASHI == 3
+#include "recursos.h"
+#endif
+
+/* Perfil das travas (-DPERFIL_LOCKS=1) e rastreio (-DRASTREIO=1), depois dos outros cabeçalhos */
+#include "rastreio.h"
+#include "perfil_locks.h"
 
 
 pthread_mutex_t mutex_m;                  /* Sessão Critica acesso as hashis */
@@ -43,6 +120,54 @@ pthread_cond_t hashi_cond[NUM_FILOSOFOS]; /* Condicional para travar e devolver
 
 size_t hashi[NUM_FILOSOFOS]; /* vetor binário simulando disponibilidade dos hashis */
 
+#if MODO_HASHI == 1
+/* Trava de cada hashi, posse do hashi é a trava travada */
+typedef struct
+{
+    _Alignas(64) pthread_mutex_t m;
+} hashi_trava_t;
+
+hashi_trava_t hashi_m[NUM_FILOSOFOS];
+#elif MODO_HASHI == 2
+/* Hashis em bits, palavra de 32 bits (tamanho da palavra do futex) */
+#define HASHI_BITS      32
+#define HASHI_PALAVRAS  ((NUM_FILOSOFOS + HASHI_BITS - 1) / HASHI_BITS)
+
+atomic_int hashi_bits[HASHI_PALAVRAS];      /* Bit '1' hashi disponível */
+atomic_int hashi_esperando[HASHI_PALAVRAS]; /* Filósofos dormindo no futex de cada palavra */
+#elif MODO_HASHI == 3
+recursos_t mesa; /* Um recurso por hashi */
+#elif MODO_HASHI == 4
+/* Estado de cada filosofo para o garçom (sessão critica mutex_m) */
+#define PENSANDO   0
+#define ESPERANDO  1
+#define COMENDO    2
+
+int estado[NUM_FILOSOFOS];
+unsigned long bilhete[NUM_FILOSOFOS]; /* Ordem de chegada de quem espera */
+unsigned long proximo_bilhete = 0;
+#endif
+
+/* Medidas de justiça de cada filosofo, uma linha de cache por filosofo */
+typedef struct
+{
+    _Alignas(64) atomic_ulong refeicoes; /* Escrito somente pelo filosofo */
+    unsigned long maior_rodadas;         /* Refeições dos vizinhos durante a maior espera */
+    latencia_t espera;                   /* Do fim do pensar até comer */
+} justica_t;
+
+justica_t justica[NUM_FILOSOFOS];
+atomic_int corte_feito = 0;          /* Primeiro filosofo satisfeito já copiou as refeições */
+unsigned long corte[NUM_FILOSOFOS];  /* Refeições de cada um nesse instante */
+
+const char *nomes_modo_hashi[] = {"mutex_m", "trava por hashi", "mascara de bits", "gerenciador",
+                                  "garcom"};
+
+size_t num_filosofos = NUM_FILOSOFOS; /* Filósofos na mesa (variável FILOSOFOS) */
+atomic_size_t comendo = 0;            /* Filósofos comendo agora */
+atomic_size_t pico_comendo = 0;       /* Maior número de filósofos comendo ao mesmo tempo */
+atomic_size_t tentativas_falhas = 0;  /* Tentativas de pegar o par que falharam */
+
 
 /* Verifica se o hashi está disponível, caso sim reserva ("pega") e retorna 1, caso nao retorna 0 */
 size_t pega_hashi(size_t pos_filosofo)
@@ -61,23 +186,271 @@ void devolver_hashi(size_t pos_filosofo)
     hashi[pos_filosofo] = 1;
 }
 
+#if MODO_HASHI == 1
+/* Pega os dois hashis do filosofo, sempre o de menor índice primeiro (espera sem falhas) */
+size_t pega_par(size_t esquerda, size_t direita)
+{
+    size_t primeiro = esquerda < direita ? esquerda : direita;
+    size_t segundo = esquerda < direita ? direita : esquerda;
+
+    pthread_mutex_lock(&hashi_m[primeiro].m);
+    pthread_mutex_lock(&hashi_m[segundo].m);
+    return 0;
+}
+
+/* Devolve os dois hashis à mesa */
+void devolve_par(size_t esquerda, size_t direita)
+{
+    pthread_mutex_unlock(&hashi_m[esquerda].m);
+    pthread_mutex_unlock(&hashi_m[direita].m);
+}
+#elif MODO_HASHI == 2
+/*
+    Pega de uma vez os hashis da 'mascara' na palavra 'p', dorme no futex
+    da palavra enquanto algum estiver ocupado. Retorna as tentativas falhas.
+*/
+size_t pega_bits(size_t p, int mascara)
+{
+    size_t falhas = 0;
+    int palavra = atomic_load(&hashi_bits[p]);
+
+    while (1)
+    {
+        if ((palavra & mascara) == mascara)
+        {
+            if (atomic_compare_exchange_strong(&hashi_bits[p], &palavra, palavra & ~mascara))
+                return falhas;
+            /* Outro filosofo mudou a palavra entre a leitura e o CAS */
+            falhas++;
+            continue;
+        }
+        falhas++;
+        /* Anuncia a espera antes de reler, quem devolve depois disso acorda a palavra */
+        atomic_fetch_add(&hashi_esperando[p], 1);
+        palavra = atomic_load(&hashi_bits[p]);
+        if ((palavra & mascara) != mascara)
+            futex_chamada(&hashi_bits[p], FUTEX_WAIT_PRIVATE, palavra);
+        atomic_fetch_sub(&hashi_esperando[p], 1);
+        palavra = atomic_load(&hashi_bits[p]);
+    }
+}
+
+/* Devolve os hashis da 'mascara' e acorda quem dorme na palavra */
+void devolve_bits(size_t p, int mascara)
+{
+    atomic_fetch_or(&hashi_bits[p], mascara);
+    if (atomic_load(&hashi_esperando[p]))
+        futex_chamada(&hashi_bits[p], FUTEX_WAKE_PRIVATE, INT_MAX);
+}
+
+/* Pega os dois hashis do filosofo, um CAS na mesma palavra ou um bit por vez na fronteira */
+size_t pega_par(size_t esquerda, size_t direita)
+{
+    size_t pe = esquerda / HASHI_BITS, pd = direita / HASHI_BITS, falhas;
+    int me = (int)(1u << (esquerda % HASHI_BITS)), md = (int)(1u << (direita % HASHI_BITS));
+
+    if (pe == pd)
+        return pega_bits(pe, me | md);
+    /* Palavras diferentes: menor índice primeiro (ordem global, sem ciclo de espera) */
+    if (esquerda < direita)
+    {
+        falhas = pega_bits(pe, me);
+        return falhas + pega_bits(pd, md);
+    }
+    falhas = pega_bits(pd, md);
+    return falhas + pega_bits(pe, me);
+}
+
+/* Devolve os dois hashis à mesa */
+void devolve_par(size_t esquerda, size_t direita)
+{
+    size_t pe = esquerda / HASHI_BITS, pd = direita / HASHI_BITS;
+    int me = (int)(1u << (esquerda % HASHI_BITS)), md = (int)(1u << (direita % HASHI_BITS));
+
+    if (pe == pd)
+        devolve_bits(pe, me | md);
+    else
+    {
+        devolve_bits(pe, me);
+        devolve_bits(pd, md);
+    }
+}
+#elif MODO_HASHI == 3
+/* Pede o par ao gerenciador (espera na fila de cada hashi, sem falhas) */
+size_t pega_par(size_t esquerda, size_t direita)
+{
+    size_t ids[2] = {esquerda, direita};
+    recursos_pega(&mesa, ids, 2);
+    return 0;
+}
+
+void devolve_par(size_t esquerda, size_t direita)
+{
+    size_t ids[2] = {esquerda, direita};
+    recursos_devolve(&mesa, ids, recursos_ordena(ids, 2));
+}
+#elif MODO_HASHI == 4
+/* Filosofo pode comer: os dois hashis livres e nenhum vizinho esperando há mais tempo */
+int garcom_libera(size_t pos_filosofo)
+{
+    size_t esquerda = (pos_filosofo + num_filosofos - 1) % num_filosofos;
+    size_t direita = (pos_filosofo + 1) % num_filosofos;
+
+    if (!hashi[pos_filosofo] || !hashi[direita])
+        return 0;
+    if (estado[esquerda] == ESPERANDO && bilhete[esquerda] < bilhete[pos_filosofo])
+        return 0;
+    if (estado[direita] == ESPERANDO && bilhete[direita] < bilhete[pos_filosofo])
+        return 0;
+    return 1;
+}
+
+/* Pede os hashis ao garçom e aguarda a vez (sem voltar a pensar, sem falhas) */
+size_t pega_par(size_t esquerda, size_t direita)
+{
+    pthread_mutex_lock(&mutex_m);
+    bilhete[esquerda] = proximo_bilhete++;
+    estado[esquerda] = ESPERANDO;
+    while (!garcom_libera(esquerda))
+        pthread_cond_wait(&hashi_cond[esquerda], &mutex_m);
+    pega_hashi(esquerda);
+    pega_hashi(direita);
+    estado[esquerda] = COMENDO;
+    pthread_mutex_unlock(&mutex_m);
+    return 0;
+}
+
+/* Devolve os hashis e acorda os dois vizinhos, únicos que podem ser liberados agora */
+void devolve_par(size_t esquerda, size_t direita)
+{
+    pthread_mutex_lock(&mutex_m);
+    devolver_hashi(esquerda);
+    devolver_hashi(direita);
+    estado[esquerda] = PENSANDO;
+    pthread_cond_signal(&hashi_cond[(esquerda + num_filosofos - 1) % num_filosofos]);
+    pthread_cond_signal(&hashi_cond[direita]);
+    pthread_mutex_unlock(&mutex_m);
+}
+#endif
+
+/* Refeições dos dois vizinhos até agora */
+unsigned long refeicoes_vizinhos(size_t pos_filosofo)
+{
+    return atomic_load_explicit(&justica[(pos_filosofo + num_filosofos - 1) % num_filosofos].refeicoes,
+                                memory_order_relaxed) +
+           atomic_load_explicit(&justica[(pos_filosofo + 1) % num_filosofos].refeicoes,
+                                memory_order_relaxed);
+}
+
+/* Registra a espera que terminou agora e conta a refeição */
+void registra_refeicao(size_t pos_filosofo, uint64_t espera_inicio, unsigned long vizinhos_antes)
+{
+    justica_t *j = &justica[pos_filosofo];
+    unsigned long rodadas = refeicoes_vizinhos(pos_filosofo) - vizinhos_antes;
+
+    latencia_registra(&j->espera, carga_agora_ns() - espera_inicio);
+    if (rodadas > j->maior_rodadas)
+        j->maior_rodadas = rodadas;
+    atomic_store_explicit(&j->refeicoes, atomic_load_explicit(&j->refeicoes, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+/* Primeiro filosofo satisfeito guarda as refeições de todos (base da razão máximo / mínimo) */
+void registra_corte(void)
+{
+    size_t i;
+    if (atomic_exchange(&corte_feito, 1))
+        return;
+    for (i = 0; i < num_filosofos; i++)
+        corte[i] = atomic_load_explicit(&justica[i].refeicoes, memory_order_relaxed);
+}
+
+/* Espera de todos e do pior filosofo, rodadas e razão das refeições no corte */
+void justica_relatorio(void)
+{
+    latencia_t total;
+    size_t i, pior = 0, rodadas_de = 0;
+    unsigned long rodadas = 0, menor = corte[0], maior = corte[0];
+    char nome[48];
+
+    latencia_zera(&total);
+    for (i = 0; i < num_filosofos; i++)
+    {
+        latencia_junta(&total, &justica[i].espera);
+        if (latencia_percentil(&justica[i].espera, 0.99) > latencia_percentil(&justica[pior].espera, 0.99))
+            pior = i;
+        if (justica[i].maior_rodadas > rodadas)
+        {
+            rodadas = justica[i].maior_rodadas;
+            rodadas_de = i;
+        }
+        if (corte[i] < menor)
+            menor = corte[i];
+        if (corte[i] > maior)
+            maior = corte[i];
+        /* Mesa pequena: uma linha por filosofo */
+        if (num_filosofos <= 10)
+        {
+            snprintf(nome, sizeof(nome), "espera filosofo %02zu", i + 1);
+            latencia_relatorio(&justica[i].espera, nome);
+        }
+    }
+    latencia_relatorio(&total, "espera por refeicao");
+    snprintf(nome, sizeof(nome), "espera pior filosofo (%02zu)", pior + 1);
+    latencia_relatorio(&justica[pior].espera, nome);
+    printf("Rodadas: maior numero de refeicoes dos vizinhos durante uma espera %lu (filosofo %02zu)\n",
+           rodadas, rodadas_de + 1);
+    if (menor)
+        printf("Refeicoes no primeiro satisfeito: min %lu, max %lu, razao max/min %.2f\n", menor, maior,
+               (double)maior / menor);
+    else
+        printf("Refeicoes no primeiro satisfeito: min 0, max %lu (algum filosofo ainda sem comer)\n", maior);
+}
+
+/* Conta o filosofo comendo e guarda o pico */
+void comeca_comer(void)
+{
+    size_t agora = atomic_fetch_add(&comendo, 1) + 1;
+    size_t pico = atomic_load_explicit(&pico_comendo, memory_order_relaxed);
+    while (agora > pico && !atomic_compare_exchange_weak(&pico_comendo, &pico, agora))
+        ;
+}
+
 /* Toma um tempo (pensando...) */
-void pensar(void)
+void pensar(carga_t *carga)
 {
-    sleep((rand() % 5 + 1) * 100);
+    carga_servico(carga, TEMPO_PENSAR);
 }
 
 /* Condições de corrida (Func Threads) */
 void *jantar(void *num_filosofo)
 {
-    size_t jantares = 0;
-    /* Semente aleatória para essa Thread (horas mais múltiplos de 60) */
-    srand((size_t)time(NULL) + (*(size_t *)num_filosofo + 1) * 60);
+    size_t jantares = 0, falhas = 0;
+    /* Início da espera atual (0 = pensando) e refeições dos vizinhos nesse instante */
+    uint64_t espera_inicio = 0;
+    unsigned long vizinhos_antes = 0;
+    /* Gerador de carga dessa Thread (semente da execução + número do filosofo) */
+    carga_t carga;
+    carga_inicia(&carga, *(size_t *)num_filosofo);
+    RASTREIO_THREAD("filosofo", *(size_t *)num_filosofo + 1);
     while (1)
     {
         /* Pensa (Delay) */
-        pensar();
+        RASTREIO_INICIO("pensa");
+        pensar(&carga);
+        RASTREIO_FIM("pensa");
+        /* Falha no modo 0 volta a pensar, a espera continua a mesma */
+        if (!espera_inicio)
+        {
+            espera_inicio = carga_agora_ns();
+            vizinhos_antes = refeicoes_vizinhos(*(size_t *)num_filosofo);
+        }
 
+        RASTREIO_INICIO("pega");
+#if MODO_HASHI
+        /* Pega os dois hashis pelo modo escolhido */
+        falhas += pega_par(*(size_t *)num_filosofo, (*(size_t *)num_filosofo + 1) % num_filosofos);
+#else
         /* Sessão critica acesso aos hashis */
         pthread_mutex_lock(&mutex_m);
         /*
@@ -103,24 +476,37 @@ void *jantar(void *num_filosofo)
             caso não ele devolve o da direita e volta a tentar novamente
             a pegar ambos hashi (Necessário a devolução para evitar deadlock).
         */
-        if (pega_hashi((*(size_t *)num_filosofo + 1) % NUM_FILOSOFOS) == 0)
+        if (pega_hashi((*(size_t *)num_filosofo + 1) % num_filosofos) == 0)
         {
             /* Falhou em pegar Hashi da direita, devolve o da esquerda */
             devolver_hashi(*(size_t *)num_filosofo);
+            falhas++;
             /* Livra a mutex e volta a pensar */
             pthread_mutex_unlock(&mutex_m);
+            RASTREIO_FIM("pega");
             continue;
         }
         /* Fim sessão critica acesso aos hashis */
         pthread_mutex_unlock(&mutex_m);
+#endif
+        RASTREIO_FIM("pega");
 
         /* Incremento de jantares */
         jantares++;
+        registra_refeicao(*(size_t *)num_filosofo, espera_inicio, vizinhos_antes);
+        espera_inicio = 0;
+        comeca_comer();
         /* Filosofo Comendo*/
-        printf("Filosofo %02ld comendo pela %02ld vez\n", *(size_t *)num_filosofo + 1, jantares);
+        LOG("Filosofo %02ld comendo pela %02ld vez\n", *(size_t *)num_filosofo + 1, jantares);
         /* Delay simulando o consumo da thread */
-        sleep(TEMPO_COMER);
+        RASTREIO_INICIO("come");
+        carga_executa_ns(TEMPO_COMER * carga_escala);
+        RASTREIO_FIM("come");
+        atomic_fetch_sub(&comendo, 1);
 
+#if MODO_HASHI
+        devolve_par(*(size_t *)num_filosofo, (*(size_t *)num_filosofo + 1) % num_filosofos);
+#else
         /* Sessão critica acesso aos hashis */
         pthread_mutex_lock(&mutex_m);
         /* Devolve hashi da esquerda*/
@@ -133,56 +519,124 @@ void *jantar(void *num_filosofo)
         /* Sessão critica acesso aos hashis */
         pthread_mutex_lock(&mutex_m);
         /* Devolve hashi da direita */
-        devolver_hashi((*(size_t *)num_filosofo + 1) % NUM_FILOSOFOS);
+        devolver_hashi((*(size_t *)num_filosofo + 1) % num_filosofos);
         /* Sinaliza que o hashi da esquerda do filosofo a direita do atual está livre agora */
-        pthread_cond_signal(&hashi_cond[(*(size_t *)num_filosofo + 1) % NUM_FILOSOFOS]);
+        pthread_cond_signal(&hashi_cond[(*(size_t *)num_filosofo + 1) % num_filosofos]);
         /* Fim sessão critica acesso aos hashis */
         pthread_mutex_unlock(&mutex_m);
+#endif
 
         /* Caso tenha atingido o limite de jantares encerra */
         if (jantares == LIMIT_JANTAS)
+        {
+            registra_corte();
             break;
+        }
     }
+    atomic_fetch_add(&tentativas_falhas, falhas);
     /* Printa antes de sair que está satisfeito (chegou ao limite de jantares) */
-    printf("Filosofo %02ld esta satisfeito !\n", *(size_t *)num_filosofo + 1);
+    LOG("Filosofo %02ld esta satisfeito !\n", *(size_t *)num_filosofo + 1);
+    return NULL;
 }
 
-int main(int argc, char const *argv[])
+int main(void)
 {
     /* Variável para iterações com FOR */
     size_t i;
     /* Thread dos filósofos */
     pthread_t filosofo_thread[NUM_FILOSOFOS];
+    /* Atributos de afinidade de cada criação */
+    pthread_attr_t atributos;
     /* Enumerador das Threas Filósofos */
     size_t pos_filosofo[NUM_FILOSOFOS];
+    /* Tamanho da mesa (variável FILOSOFOS), início e fim do jantar */
+    const char *v = getenv("FILOSOFOS");
+    uint64_t inicio, fim;
 
-    /* Semente aleatória (clock cpu) */
-    srand(time(NULL));
+    if (v && strtoul(v, NULL, 10) >= 2 && strtoul(v, NULL, 10) <= NUM_FILOSOFOS)
+        num_filosofos = strtoul(v, NULL, 10);
+
+    /* Semente e distribuição da carga (variáveis CARGA_* de ambiente) */
+    carga_configura();
+    /* Posicionamento das Threads (variável AFINIDADE) */
+    if (afinidade_configura(NULL) < 0)
+    {
+        fprintf(stderr, "AFINIDADE invalida: '%s'\n", getenv("AFINIDADE"));
+        return 1;
+    }
+    afinidade_papel(AFINIDADE_FILOSOFO, num_filosofos);
 
     /* Configurando os hashis como disponíveis */
     memset(&hashi, 1, sizeof(hashi));
+    /* Hashis no nó NUMA dos filósofos */
+    afinidade_memoria(hashi, sizeof(hashi));
 
     /* Inicialização da Mutex  */
     pthread_mutex_init(&mutex_m, NULL);
+#if MODO_HASHI == 1
+    /* Travas dos hashis no nó NUMA dos filósofos */
+    afinidade_memoria(hashi_m, sizeof(hashi_m));
+    for (i = 0; i < NUM_FILOSOFOS; i++)
+        pthread_mutex_init(&hashi_m[i].m, NULL);
+#elif MODO_HASHI == 2
+    /* Todos os bits '1', hashis disponíveis */
+    for (i = 0; i < HASHI_PALAVRAS; i++)
+        atomic_init(&hashi_bits[i], -1);
+    afinidade_memoria(hashi_bits, sizeof(hashi_bits));
+#elif MODO_HASHI == 3
+    if (recursos_inicia(&mesa, num_filosofos))
+        return 1;
+    afinidade_memoria(mesa.recursos, num_filosofos * sizeof(recurso_t));
+#endif
 
     /* Inicialização das Mutex condicionais */
     for (i = 0; i < NUM_FILOSOFOS; i++)
         pthread_cond_init((hashi_cond + i), NULL);
 
+    printf("Semente: %llu, distribuicao: %s\n", (unsigned long long)carga_semente,
+           carga_nome_distribuicao());
+    afinidade_relatorio();
     printf("O jantar esta servido...\n\n");
 
+    /* Escritor de fundo do log (antes das Threads) */
+    log_inicia();
+
     /* Inicialização das Threads (inicia condições de corrida) */
-    for (i = 0; i < NUM_FILOSOFOS; i++)
+    inicio = carga_agora_ns();
+    for (i = 0; i < num_filosofos; i++)
     {
         pos_filosofo[i] = i;
-        pthread_create((filosofo_thread + i), NULL, (void *)&jantar, (void *)(pos_filosofo + i));
+        pthread_create((filosofo_thread + i), afinidade_attr(&atributos, AFINIDADE_FILOSOFO, i),
+                       (void *)&jantar, (void *)(pos_filosofo + i));
+        pthread_attr_destroy(&atributos);
     }
 
     /* Aguardando o retorno das Thread */
-    for (i = 0; i < NUM_FILOSOFOS; i++)
+    for (i = 0; i < num_filosofos; i++)
         pthread_join(filosofo_thread[i], NULL);
+    fim = carga_agora_ns();
 
+    /* Escreve o restante do log (Threads já encerradas) */
+    log_finaliza();
+
+    /* Cada filosofo come LIMIT_JANTAS vezes */
+    printf("\nMesa %zu filosofos (%s): refeicoes %zu em %.3f s (%.1f/s), pico comendo %zu\n",
+           num_filosofos, nomes_modo_hashi[MODO_HASHI], num_filosofos * LIMIT_JANTAS,
+           (fim - inicio) / 1e9, num_filosofos * LIMIT_JANTAS / ((fim - inicio) / 1e9),
+           atomic_load(&pico_comendo));
+    printf("Tentativas falhas: %zu (%.2f por refeicao)\n", atomic_load(&tentativas_falhas),
+           (double)atomic_load(&tentativas_falhas) / (num_filosofos * LIMIT_JANTAS));
+    justica_relatorio();
+    perfil_relatorio();
+    RASTREIO_EXPORTA();
+#if MODO_HASHI == 3
+    recursos_relatorio(&mesa, "hashis");
+    recursos_destroi(&mesa);
+#endif
     printf("\nFim\n");
+#if TAREFAS
+    tarefas_relatorio();
+#endif
 
     return 0;
 }
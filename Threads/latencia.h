@@ -0,0 +1,110 @@
+/****************************************************************************
+ * Histograma de latências por thread para os programas de Threads, cada    *
+ *  thread registra no seu próprio 'latencia_t' (sem trava) e a main junta  *
+ *  todos ao final para os percentis.                                       *
+ *                                                                          *
+ * Faixas log-lineares: cada potência de 2 é dividida em 2^LAT_SUB_BITS     *
+ *  faixas iguais, erro relativo menor que 1 / 2^LAT_SUB_BITS (6.25%) em    *
+ *  qualquer escala, de nanosegundos a minutos, com memória fixa.           *
+ *                                                                          *
+ * Os percentis informam o limite superior da faixa (nunca subestima).      *
+ *************************************************************************** */
+
+#ifndef LATENCIA_H
+#define LATENCIA_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Subdivisões de cada potência de 2 (bits) */
+#define LAT_SUB_BITS    4
+#define LAT_SUB         (1u << LAT_SUB_BITS)
+/* Faixas para cobrir todo o intervalo de 64 bits */
+#define LAT_FAIXAS      ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef struct
+{
+    uint64_t contagem[LAT_FAIXAS];
+    uint64_t n;    /* Amostras registradas */
+    uint64_t soma; /* Para a média */
+    uint64_t max;  /* Maior amostra (exata) */
+} latencia_t;
+
+
+static inline void latencia_zera(latencia_t *l)
+{
+    memset(l, 0, sizeof(*l));
+}
+
+/* Faixa de uma amostra, valores menores que LAT_SUB têm faixa própria */
+static inline size_t latencia_faixa(uint64_t ns)
+{
+    int e;
+    if (ns < LAT_SUB)
+        return (size_t)ns;
+    e = 63 - __builtin_clzll(ns);
+    return ((size_t)(e - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+           (size_t)((ns >> (e - LAT_SUB_BITS)) & (LAT_SUB - 1));
+}
+
+/* Limite superior de uma faixa */
+static inline uint64_t latencia_limite(size_t faixa)
+{
+    size_t g = faixa >> LAT_SUB_BITS, s = faixa & (LAT_SUB - 1);
+    if (g == 0)
+        return (uint64_t)faixa;
+    return ((uint64_t)(LAT_SUB + s) << (g - 1)) + ((1ull << (g - 1)) - 1);
+}
+
+static inline void latencia_registra(latencia_t *l, uint64_t ns)
+{
+    l->contagem[latencia_faixa(ns)]++;
+    l->n++;
+    l->soma += ns;
+    if (ns > l->max)
+        l->max = ns;
+}
+
+/* Soma as amostras de 'origem' em 'destino' */
+static inline void latencia_junta(latencia_t *destino, const latencia_t *origem)
+{
+    size_t i;
+    for (i = 0; i < LAT_FAIXAS; i++)
+        destino->contagem[i] += origem->contagem[i];
+    destino->n += origem->n;
+    destino->soma += origem->soma;
+    if (origem->max > destino->max)
+        destino->max = origem->max;
+}
+
+/* Percentil 'p' (0 a 1) */
+static inline uint64_t latencia_percentil(const latencia_t *l, double p)
+{
+    uint64_t alvo = (uint64_t)(p * (double)l->n + 0.5), acumulado = 0;
+    size_t i;
+
+    if (!l->n)
+        return 0;
+    if (alvo < 1)
+        alvo = 1;
+    for (i = 0; i < LAT_FAIXAS; i++)
+    {
+        acumulado += l->contagem[i];
+        if (acumulado >= alvo)
+            break;
+    }
+    /* O limite da faixa não passa do máximo observado */
+    return latencia_limite(i) < l->max ? latencia_limite(i) : l->max;
+}
+
+/* Imprime amostras, média e percentis em microssegundos */
+static inline void latencia_relatorio(const latencia_t *l, const char *nome)
+{
+    printf("Latencia %s (us): amostras %llu, media %.1f, p50 %.1f, p99 %.1f, p999 %.1f, max %.1f\n",
+           nome, (unsigned long long)l->n, l->n ? (double)l->soma / l->n / 1e3 : 0.0,
+           latencia_percentil(l, 0.50) / 1e3, latencia_percentil(l, 0.99) / 1e3,
+           latencia_percentil(l, 0.999) / 1e3, l->max / 1e3);
+}
+
+#endif
@@ -11,187 +11,1090 @@
  *  escrita, ou seja leitores tem liberdade de acesso mútuo já escritores  *
  *  não tem, bloqueando todos                                              *
  *                                                                         *
+ * Modo 'MODO_LEITURA' (compilação com -DMODO_LEITURA=1): cada leitor se   *
+ *  registra no próprio indicador (uma linha de cache por leitor), entrada *
+ *  e saída com poucas operações atômicas, sem travas nem chamadas de      *
+ *  sistema enquanto não houver escritor. Somente o escritor percorre os   *
+ *  indicadores e aguarda os leitores registrados saírem, a prioridade dos *
+ *  escritores por locket_flag se mantém. No modo mutex (padrão) o último  *
+ *  leitor destrava a mutex_m travada pelo primeiro, indefinido para mutex *
+ *  normal do pthread.                                                     *
+ *                                                                         *
+ * Seqlock (-DMODO_LEITURA=2): leitores leem sem travas a sequência par,   *
+ *  o critico e de novo a sequência, e repetem caso um escritor tenha      *
+ *  passado (sequência ímpar durante a escrita). Leitores não bloqueiam    *
+ *  escritores nem uns aos outros, escritores mantêm a ordem da mutex_m;   *
+ *  cada repetição aparece no log com a taxa do leitor.                    *
+ *                                                                         *
+ * RCU (-DMODO_LEITURA=3): o critico é uma tabela de TAM_TABELA entradas,  *
+ *  o escritor copia a versão atual, altera a cópia e publica com uma      *
+ *  troca atômica do ponteiro; leitores leem a versão atual sem travas e   *
+ *  sem esperar escritores. Versões substituídas são liberadas por época   *
+ *  (cada leitor anuncia a época na entrada), o log mostra as pendentes e  *
+ *  o relatório a latência das leituras durante e sem escrita.             *
+ *                                                                         *
+ * Política 'POLITICA' do modo mutex: escritores primeiro (0, padrão, a    *
+ *  locket_flag), leitores primeiro (1), fases alternadas (2, leitores que *
+ *  aguardam entram todos após uma escrita e antes da próxima) ou fila de  *
+ *  bilhetes por ordem de chegada (3). Cada Thread registra a espera até   *
+ *  entrar e cada papel a maior sequência de aquisições do outro papel     *
+ *  enquanto aguardava (inanição), no log quando cresce e no relatório     *
+ *  junto do máximo e percentis da espera de cada papel.                   *
+ *                                                                         *
+ * Combinação (-DCOMBINACAO=1, qualquer modo): cada escritor publica o     *
+ *  pedido (entrada e valor) no próprio registro, quem assume a vez de     *
+ *  combinador entra na escrita uma vez, aplica todos os pedidos pendentes *
+ *  e publica uma vez, os leitores são barrados uma vez por combinação e   *
+ *  não por escritor; o relatório mostra escritas por entrada e quantas    *
+ *  vezes a locket_flag barrou leitores.                                   *
+ *                                                                         *
+ * Afinidade (variável AFINIDADE de 'afinidade.h', compacta, espalhada ou  *
+ *  listas por papel): leitores e escritores criados na CPU da política,   *
+ *  posicionamento no início.                                              *
+ *                                                                         *
+ * Tarefas 'TAREFAS' (compilação com -DTAREFAS=1): leitores e escritores   *
+ *  viram tarefas M:N de 'tarefas.h' sobre poucos trabalhadores, a espera  *
+ *  nas travas estaciona somente a tarefa (NUM_LEIT e NUM_ESCR aceitam     *
+ *  milhares com -DNUM_LEIT=N).                                            *
+ *                                                                         *
+ * Execução limitada (variáveis EXECUCAO_DURACAO em segundos ou            *
+ *  EXECUCAO_OPERACOES): as Threads saem do laço ao fim e o programa       *
+ *  mostra leituras e escritas por segundo e a espera em cada trava        *
+ *  (mutex_m, leitura_m, inanicao_m). EXECUCAO_LEITORES e                  *
+ *  EXECUCAO_ESCRITORES usam menos Threads, EXECUCAO_LEITURA (fração das   *
+ *  operações que são leituras) ajusta o intervalo dos escritores e        *
+ *  EXECUCAO_SESSAO_US o tempo dentro de cada leitura e escrita.           *
+ *                                                                         *
+ * ** Tempos e valores sorteados por 'carga.h' (gerador por Thread com     *
+ *    semente explícita, mesma semente reproduz a mesma carga).            *
+ * ** Saída das Threads pelo log assíncrono de 'log_assincrono.h',         *
+ *    compilação com -DSEM_LOG remove todo o log.                          *
+ * ** Perfil das travas com -DPERFIL_LOCKS=1 ('perfil_locks.h'), relatório *
+ *    no final ordenado pela espera total.                                 *
+ * ** Linha do tempo com -DRASTREIO=1 ('rastreio.h'): leituras, escritas e *
+ *    esperas por Thread em JSON para o Perfetto ou o chrome://tracing,    *
+ *    exportada ao final da execução limitada.                             *
  * ** GCC incluir a biblioteca pthread através do parâmetro '-lpthread'    *
- * ** Este Programa *NÃO* Finaliza.                                        *
+ * ** Este Programa *NÃO* Finaliza, exceto na execução limitada.           *
  *************************************************************************** */
 
+/* sched_getaffinity e pthread_attr_setaffinity_np ('afinidade.h') */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <time.h>
 
-#ifdef _WIN32
-#include <Windows.h>
-#define sleep(ms) Sleep(ms)
-#elif __linux__
-#include <unistd.h>
-#else
-#error "OS Not Supported"
+#include "log_assincrono.h"
+#include "afinidade.h"
+
+/* Atores em Threads do sistema (0) ou em tarefas M:N de 'tarefas.h' (1) */
+#ifndef TAREFAS
+#define TAREFAS 0
 #endif
+#if TAREFAS
+/* Após o log (escritor de fundo segue Thread do sistema) e antes da carga (esperas estacionam) */
+#include "tarefas.h"
+#endif
+
+#include "carga.h"
+#include "latencia.h"
+
+/* Perfil das travas (-DPERFIL_LOCKS=1) e rastreio (-DRASTREIO=1), depois dos outros cabeçalhos */
+#include "rastreio.h"
+#include "perfil_locks.h"
 
 /* Número de Threads de Leitura */
+#ifndef NUM_LEIT
 #define NUM_LEIT 20
+#endif
 /* Número de Threads de Escrita */
+#ifndef NUM_ESCR
 #define NUM_ESCR 5
+#endif
+
+/* Tempo médio entre leituras e entre escritas (distribuição em 'carga.h') */
+#define TEMPO_LEIT CARGA_MS(400)
+#define TEMPO_ESCR CARGA_MS(200)
+
+/* Entradas da tabela compartilhada (critico) */
+#ifndef TAM_TABELA
+#define TAM_TABELA 64
+#endif
+
+/* Entrada dos leitores: mutexes do exemplo (0), indicadores por leitor sem travas (1), seqlock (2) ou RCU (3) */
+#define MODO_MUTEX       0
+#define MODO_INDICADORES 1
+#define MODO_SEQLOCK     2
+#define MODO_RCU         3
+#ifndef MODO_LEITURA
+#define MODO_LEITURA MODO_MUTEX
+#endif
+
+/* Justiça do modo mutex: escritores primeiro (0, locket_flag), leitores primeiro (1), fases (2) ou bilhetes (3) */
+#define POLITICA_ESCRITOR 0
+#define POLITICA_LEITOR   1
+#define POLITICA_FASES    2
+#define POLITICA_FIFO     3
+#ifndef POLITICA
+#define POLITICA POLITICA_ESCRITOR
+#endif
+#if POLITICA != POLITICA_ESCRITOR && MODO_LEITURA != MODO_MUTEX
+#error "POLITICA somente no modo mutex (MODO_LEITURA=0)"
+#endif
+
+/* Escritas combinadas: um escritor aplica os pedidos de todos em uma única entrada (1) */
+#ifndef COMBINACAO
+#define COMBINACAO 0
+#endif
+
+/* Valores da tabela, atômicos no seqlock (lidos durante a escrita e descartados pela sequência) */
+#if MODO_LEITURA == MODO_SEQLOCK
+typedef _Atomic unsigned int valor_t;
+#else
+typedef unsigned int valor_t;
+#endif
+
+/* Simulando memoria critica compartilhada: tabela de configuração e versão da última escrita */
+typedef struct tabela
+{
+    valor_t versao;
+    valor_t valores[TAM_TABELA];
+    struct tabela *prox;      /* Próxima versão aguardando recolhimento (RCU) */
+    unsigned long long epoca; /* Época em que a versão foi substituída (RCU) */
+} tabela_t;
 
 
 pthread_mutex_t mutex_m, leitura_m, inanicao_m; /* Mutexs para sessões */
 pthread_cond_t anti_inanicao_cond;              /* Variável condicional da mutex */
 
-unsigned int num_leitores = 0; /* Número de leitores ativos */
-unsigned int locket_flag  = 0; /* Trava para priorizar escritores */
-unsigned int critico      = 0; /* Simulando memoria critica compartilhada */
+/* Espera em cada trava (registrada já com a trava, sem disputa no histograma) */
+#define TRAVA_MUTEX    0
+#define TRAVA_LEITURA  1
+#define TRAVA_INANICAO 2
+const char *nomes_trava[] = {"mutex_m", "leitura_m", "inanicao_m"};
+latencia_t espera_travas[3];
 
+/* Execução limitada (variáveis EXECUCAO_* de ambiente, 0 = sem limite) */
+double duracao_s = 0;              /* Segundos de execução */
+unsigned long limite_operacoes = 0; /* Leituras e escritas somadas */
+size_t num_leit = NUM_LEIT, num_escr = NUM_ESCR;
+uint64_t tempo_leit = TEMPO_LEIT, tempo_escr = TEMPO_ESCR, sessao_ns = 0;
+atomic_int encerrar = 0;           /* Fim da execução limitada, Threads saem do laço */
 
-void *leitor(void *num_thread)
+/* Operações de cada Thread (somente a dona incrementa), uma linha de cache por Thread */
+typedef struct
+{
+    _Alignas(64) atomic_ulong n;
+} contagem_t;
+
+contagem_t leituras_feitas[NUM_LEIT], escritas_feitas[NUM_ESCR];
+
+unsigned int num_leitores = 0;         /* Número de leitores ativos */
+atomic_ulong leitores_bloqueados = 0;  /* Entradas de leitores barradas pela locket_flag */
+_Atomic unsigned int locket_flag  = 0; /* Trava para priorizar escritores */
+#if MODO_LEITURA == MODO_RCU
+_Atomic(tabela_t *) critico;           /* Versão atual, trocada inteira pelo escritor */
+#else
+tabela_t tabela;
+tabela_t *critico = &tabela;           /* Simulando memoria critica compartilhada */
+#endif
+
+/* pthread_mutex_lock medindo a espera até conseguir a trava */
+void trava(pthread_mutex_t *m, int qual)
+{
+    uint64_t inicio = carga_agora_ns();
+    pthread_mutex_lock(m);
+    latencia_registra(&espera_travas[qual], carga_agora_ns() - inicio);
+}
+
+/* Soma uma operação ao contador da própria Thread (sem instrução atômica de escrita) */
+void conta(contagem_t *c)
+{
+    atomic_store_explicit(&c->n, atomic_load_explicit(&c->n, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+#if MODO_LEITURA == MODO_INDICADORES
+/* Indicador de leitura de cada leitor, um por linha de cache (sem compartilhamento falso) */
+typedef struct
+{
+    _Alignas(64) atomic_int ativo;
+} indicador_t;
+
+indicador_t indicadores[NUM_LEIT];
+pthread_cond_t saida_leitor_cond; /* Escritor aguarda os leitores ativos (com leitura_m) */
+
+/* Algum leitor ainda registrado (somente o escritor percorre os indicadores) */
+int leitores_ativos(void)
+{
+    size_t i;
+    for (i = 0; i < NUM_LEIT; i++)
+        if (atomic_load(&indicadores[i].ativo))
+            return 1;
+    return 0;
+}
+#elif MODO_LEITURA == MODO_SEQLOCK
+atomic_uint sequencia = 0; /* Ímpar durante uma escrita, incrementada somente pelo escritor */
+
+/* Sequência vista na entrada e contadores de cada leitor, uma linha de cache por leitor */
+typedef struct
+{
+    _Alignas(64) unsigned int vista;
+    unsigned long leituras, repeticoes; /* long: o LOG só leva argumentos long */
+} leitor_seq_t;
+
+leitor_seq_t leitores_seq[NUM_LEIT];
+#elif MODO_LEITURA == MODO_RCU
+atomic_ullong epoca_global = 1; /* Avança a cada versão publicada */
+atomic_int escritas_ativas = 0; /* Escritores entre a cópia e a publicação */
+
+/* Época anunciada e latências de cada leitor, uma linha de cache por leitor */
+typedef struct
+{
+    _Alignas(64) atomic_ullong epoca; /* Época vista na entrada, 0 fora da leitura */
+    uint64_t inicio;
+    int durante;                      /* Leitura iniciada com escrita em andamento */
+    latencia_t durante_escrita, sem_escrita;
+} leitor_rcu_t;
+
+leitor_rcu_t leitores_rcu[NUM_LEIT];
+
+/* Versões substituídas aguardando os leitores (somente com mutex_m) */
+tabela_t *rascunho;       /* Cópia em escrita */
+tabela_t *pendentes;
+size_t num_pendentes = 0, pico_pendentes = 0, publicadas = 0, recolhidas = 0;
+
+/*
+    Libera as versões substituídas antes da menor época anunciada por um
+    leitor ativo: leitor que anunciou depois da substituição já encontra
+    a nova versão no ponteiro.
+*/
+void rcu_recolhe(void)
+{
+    unsigned long long menor = ~0ull, e;
+    tabela_t **p, *t;
+    size_t i;
+
+    for (i = 0; i < NUM_LEIT; i++)
+        if ((e = atomic_load(&leitores_rcu[i].epoca)) && e < menor)
+            menor = e;
+    for (p = &pendentes; *p;)
+    {
+        if ((*p)->epoca < menor)
+        {
+            t = *p;
+            *p = t->prox;
+            free(t);
+            num_pendentes--;
+            recolhidas++;
+        }
+        else
+            p = &(*p)->prox;
+    }
+}
+
+/* Fim da execução (Threads encerradas): libera as versões pendentes e a atual */
+void rcu_libera(void)
+{
+    tabela_t *t;
+    while ((t = pendentes))
+    {
+        pendentes = t->prox;
+        free(t);
+    }
+    free(atomic_exchange(&critico, NULL));
+}
+#endif
+
+#if MODO_LEITURA == MODO_MUTEX
+#define PAPEL_LEITOR   0
+#define PAPEL_ESCRITOR 1
+
+const char *nomes_politica[] = {"escritores primeiro", "leitores primeiro", "fases alternadas", "fila de bilhetes"};
+
+atomic_uint esperando[2];  /* Threads de cada papel a caminho da sessão */
+atomic_ulong fome[2];      /* Aquisições seguidas do outro papel enquanto este aguardava */
+atomic_ulong maior_fome[2];
+
+/* Espera de cada Thread até entrar na sessão, uma linha de cache por Thread */
+typedef struct
+{
+    _Alignas(64) latencia_t espera;
+} espera_t;
+
+espera_t espera_leitores[NUM_LEIT], espera_escritores[NUM_ESCR];
+
+/* Início da espera de uma Thread do papel */
+uint64_t espera_inicia(int papel)
 {
-    /* Semente aleatória para essa Thread (horas mais múltiplos de 60) */
-    srand((size_t)time(NULL) + (*(size_t *)num_thread + 1) * 60);
+    atomic_fetch_add(&esperando[papel], 1);
+    return carga_agora_ns();
+}
+
+/*
+    Thread do papel entrou na sessão: registra a espera, zera a sequência
+    sem acesso do papel e soma uma aquisição à sequência do outro papel
+    caso alguma Thread dele esteja aguardando.
+*/
+void espera_registra(int papel, espera_t *e, uint64_t inicio)
+{
+    int outro = !papel;
+    unsigned long seq, maior;
+
+    latencia_registra(&e->espera, carga_agora_ns() - inicio);
+    atomic_fetch_sub(&esperando[papel], 1);
+    atomic_store(&fome[papel], 0);
+    if (!atomic_load(&esperando[outro]))
+        return;
+    seq = atomic_fetch_add(&fome[outro], 1) + 1;
+    maior = atomic_load(&maior_fome[outro]);
+    while (seq > maior)
+        if (atomic_compare_exchange_weak(&maior_fome[outro], &maior, seq))
+        {
+            LOG(outro == PAPEL_LEITOR ? "Inanicao: leitores aguardando ha %ld aquisicoes\n"
+                                      : "Inanicao: escritores aguardando ha %ld aquisicoes\n", seq);
+            break;
+        }
+}
+#endif
+
+#if POLITICA != POLITICA_ESCRITOR
+/*
+    Monitor das demais políticas, todo o estado com inanicao_m e uma única
+    condicional (cada mudança acorda todos, cada um confere a sua vez):
+    - leitores primeiro: leitor só espera escritor ativo;
+    - fases: leitor que encontra escritor ativo ou esperando aguarda o fim
+      de uma escrita e entra com todos os leitores daquela fase antes do
+      próximo escritor (leitores e escritores alternam);
+    - bilhetes: ordem de chegada, leitores seguidos entram juntos.
+*/
+pthread_cond_t politica_cond;
+unsigned int escrevendo = 0, escritores_esperando = 0, leitores_esperando = 0, leitores_liberados = 0;
+unsigned long long fase_leitura = 0, proximo_bilhete = 0, vez = 0;
+
+void politica_entra_leitura(size_t num)
+{
+    trava(&inanicao_m, TRAVA_INANICAO);
+#if POLITICA == POLITICA_LEITOR
+    while (escrevendo)
+    {
+        LOG("Leitor aguardando: %02ld\n", num);
+        pthread_cond_wait(&politica_cond, &inanicao_m);
+    }
+#elif POLITICA == POLITICA_FASES
+    if (escrevendo || escritores_esperando)
+    {
+        unsigned long long fase = fase_leitura;
+        leitores_esperando++;
+        while (fase == fase_leitura)
+        {
+            LOG("Leitor aguardando: %02ld\n", num);
+            pthread_cond_wait(&politica_cond, &inanicao_m);
+        }
+        leitores_esperando--;
+        leitores_liberados--;
+    }
+#else
+    unsigned long long bilhete = proximo_bilhete++;
+    while (bilhete != vez || escrevendo)
+    {
+        LOG("Leitor aguardando: %02ld\n", num);
+        pthread_cond_wait(&politica_cond, &inanicao_m);
+    }
+    /* Próximo bilhete pode ser outro leitor */
+    vez++;
+    pthread_cond_broadcast(&politica_cond);
+#endif
+    num_leitores++;
+    pthread_mutex_unlock(&inanicao_m);
+}
+
+void politica_sai_leitura(void)
+{
+    trava(&inanicao_m, TRAVA_INANICAO);
+    if (--num_leitores == 0)
+        pthread_cond_broadcast(&politica_cond);
+    pthread_mutex_unlock(&inanicao_m);
+}
+
+void politica_entra_escrita(size_t num)
+{
+    trava(&inanicao_m, TRAVA_INANICAO);
+    LOG("Novo Escritor: %02ld\n", num);
+#if POLITICA == POLITICA_LEITOR
+    while (escrevendo || num_leitores)
+        pthread_cond_wait(&politica_cond, &inanicao_m);
+#elif POLITICA == POLITICA_FASES
+    /* Leitores liberados pela última escrita entram antes */
+    escritores_esperando++;
+    while (escrevendo || num_leitores || leitores_liberados)
+        pthread_cond_wait(&politica_cond, &inanicao_m);
+    escritores_esperando--;
+#else
+    unsigned long long bilhete = proximo_bilhete++;
+    while (bilhete != vez || escrevendo || num_leitores)
+        pthread_cond_wait(&politica_cond, &inanicao_m);
+    vez++;
+#endif
+    escrevendo = 1;
+    pthread_mutex_unlock(&inanicao_m);
+}
+
+void politica_sai_escrita(size_t num)
+{
+    trava(&inanicao_m, TRAVA_INANICAO);
+    escrevendo = 0;
+#if POLITICA == POLITICA_FASES
+    /* Fim da fase de escrita, libera os leitores que aguardavam */
+    if (leitores_esperando)
+    {
+        fase_leitura++;
+        leitores_liberados += leitores_esperando;
+    }
+#endif
+    pthread_cond_broadcast(&politica_cond);
+    LOG("Fim do Escritor: %02ld\n", num);
+    pthread_mutex_unlock(&inanicao_m);
+}
+#endif
+
+
+/* Entrada do leitor 'num' (1 a NUM_LEIT) na leitura, retorna a tabela a ler */
+const tabela_t *entra_leitura(size_t num)
+{
+#if MODO_LEITURA == MODO_MUTEX
+    uint64_t inicio = espera_inicia(PAPEL_LEITOR);
+#endif
+#if MODO_LEITURA == MODO_INDICADORES
+    /*
+        Caminho rápido: registra no próprio indicador e confere se não
+        existe escritor. Registro antes da leitura da flag e o escritor
+        incrementa a flag antes de percorrer os indicadores (seq_cst), assim
+        ou o leitor vê a flag ou o escritor vê o leitor.
+    */
     while (1)
     {
-        sleep((rand() % 3 + 3) * 100);
+        atomic_store(&indicadores[num - 1].ativo, 1);
+        if (!atomic_load(&locket_flag))
+            return critico;
+        /* Escritor esperando ou ativo, desfaz o registro e aguarda */
+        atomic_store(&indicadores[num - 1].ativo, 0);
+        trava(&leitura_m, TRAVA_LEITURA);
+        pthread_cond_signal(&saida_leitor_cond);
+        pthread_mutex_unlock(&leitura_m);
 
-        /* Sessão critica da variável locket_flag */
-        pthread_mutex_lock(&inanicao_m);
-        /*
-            Caso exista um novo escritor, trava a entrada de novos leitores
-            Aqui irá manter novos leitores esperando, enquanto as ativas
-            continuem até sair.
-        */
+        trava(&inanicao_m, TRAVA_INANICAO);
+        if (locket_flag)
+            atomic_fetch_add_explicit(&leitores_bloqueados, 1, memory_order_relaxed);
         while (locket_flag)
         {
-            /* Leitores esperam até não ter mais escritores ativos */
-            printf("Leitor aguardando: %02ld\n", *(size_t *)num_thread);
+            LOG("Leitor aguardando: %02ld\n", num);
             pthread_cond_wait(&anti_inanicao_cond, &inanicao_m);
         }
-        /* Fim sessão critica da variável locket_flag */
         pthread_mutex_unlock(&inanicao_m);
+    }
+#elif MODO_LEITURA == MODO_SEQLOCK
+    /*
+        Leitura otimista: aguarda (sem travas e sem escrever em memória
+        compartilhada) uma sequência par e guarda, sai_leitura() confere
+        se a sequência continua a mesma.
+    */
+    unsigned int seq;
+    while ((seq = atomic_load_explicit(&sequencia, memory_order_acquire)) & 1)
+        ;
+    leitores_seq[num - 1].vista = seq;
+#elif MODO_LEITURA == MODO_RCU
+    /*
+        Anuncia a época antes de ler o ponteiro no retorno (seq_cst, o
+        escritor troca o ponteiro antes de percorrer as épocas), a versão
+        lida não é liberada até a saída. Sem travas e sem esperar escritores.
+    */
+    leitor_rcu_t *l = &leitores_rcu[num - 1];
+    l->inicio = carga_agora_ns();
+    l->durante = atomic_load_explicit(&escritas_ativas, memory_order_relaxed) != 0;
+    atomic_store(&l->epoca, atomic_load(&epoca_global));
+#elif POLITICA != POLITICA_ESCRITOR
+    politica_entra_leitura(num);
+#else
+    /* Sessão critica da variável locket_flag */
+    trava(&inanicao_m, TRAVA_INANICAO);
+    /*
+        Caso exista um novo escritor, trava a entrada de novos leitores
+        Aqui irá manter novos leitores esperando, enquanto as ativas
+        continuem até sair.
+    */
+    if (locket_flag)
+        atomic_fetch_add_explicit(&leitores_bloqueados, 1, memory_order_relaxed);
+    while (locket_flag)
+    {
+        /* Leitores esperam até não ter mais escritores ativos */
+        LOG("Leitor aguardando: %02ld\n", num);
+        pthread_cond_wait(&anti_inanicao_cond, &inanicao_m);
+    }
+    /* Fim sessão critica da variável locket_flag */
+    pthread_mutex_unlock(&inanicao_m);
 
-        /* Sessão critica da variável num_leitores */
-        pthread_mutex_lock(&leitura_m);
-        /* Caso seja o primeiro leitor bloqueia a mutex de escrita */
-        if (++num_leitores == 1)
+    /* Sessão critica da variável num_leitores */
+    trava(&leitura_m, TRAVA_LEITURA);
+    /* Caso seja o primeiro leitor bloqueia a mutex de escrita */
+    if (++num_leitores == 1)
+    {
+        /* Bloqueia escritores */
+        trava(&mutex_m, TRAVA_MUTEX);
+    }
+    /* Fim sessão critica da variável num_leitores */
+    pthread_mutex_unlock(&leitura_m);
+#endif
+#if MODO_LEITURA == MODO_MUTEX
+    espera_registra(PAPEL_LEITOR, &espera_leitores[num - 1], inicio);
+#endif
+    return critico;
+}
+
+/* Saída do leitor 'num' da leitura, retorna 0 caso a leitura deva ser repetida (seqlock) */
+int sai_leitura(size_t num)
+{
+#if MODO_LEITURA == MODO_INDICADORES
+    atomic_store(&indicadores[num - 1].ativo, 0);
+    /* Somente com escritor esperando, acorda para conferir os indicadores */
+    if (atomic_load(&locket_flag))
+    {
+        trava(&leitura_m, TRAVA_LEITURA);
+        pthread_cond_signal(&saida_leitor_cond);
+        pthread_mutex_unlock(&leitura_m);
+    }
+#elif MODO_LEITURA == MODO_SEQLOCK
+    leitor_seq_t *l = &leitores_seq[num - 1];
+
+    /* Leituras do critico antes da nova leitura da sequência */
+    atomic_thread_fence(memory_order_acquire);
+    l->leituras++;
+    if (atomic_load_explicit(&sequencia, memory_order_relaxed) == l->vista)
+        return 1;
+    /* Escritor passou durante a leitura */
+    l->repeticoes++;
+    LOG("Leitor repetindo: %02ld (%lu de %lu leituras)\n", num, l->repeticoes, l->leituras);
+    return 0;
+#elif MODO_LEITURA == MODO_RCU
+    leitor_rcu_t *l = &leitores_rcu[num - 1];
+    atomic_store_explicit(&l->epoca, 0, memory_order_release);
+    latencia_registra(l->durante ? &l->durante_escrita : &l->sem_escrita, carga_agora_ns() - l->inicio);
+#elif POLITICA != POLITICA_ESCRITOR
+    (void)num;
+    politica_sai_leitura();
+#else
+    (void)num;
+    /* Sessão critica da variável num_leitores */
+    trava(&leitura_m, TRAVA_LEITURA);
+    /* Último leitor ativo ao sair libera os escritores */
+    if (--num_leitores == 0)
+    {
+        /* Destrava os escritores */
+        pthread_mutex_unlock(&mutex_m);
+    }
+    /* Fim sessão critica da variável num_leitores */
+    pthread_mutex_unlock(&leitura_m);
+#endif
+    return 1;
+}
+
+/* Entrada do escritor 'num' na escrita (exclusiva), retorna a tabela a escrever */
+tabela_t *entra_escrita(size_t num)
+{
+#if MODO_LEITURA == MODO_MUTEX
+    uint64_t inicio = espera_inicia(PAPEL_ESCRITOR);
+#endif
+#if POLITICA != POLITICA_ESCRITOR
+    politica_entra_escrita(num);
+#else
+    /* Sessão critica da variável locket_flag */
+    trava(&inanicao_m, TRAVA_INANICAO);
+    /*
+        Flag não binaria (0 == Falso, caso contrario é Verdadeiro)
+        Incrementa igualmente ao número de escritores ativos assim
+        leitores esperam até todos escritores deixar sessão critica.
+    */
+    LOG("Novo Escritor: %02ld\n", num);
+    locket_flag++;
+
+    /* 
+        Sessão critica da variável critico 
+         Com essa lock dentro da lock do inanicao_m garantimos
+         que mais de um escritor pode entrar e travar os leitores
+         porém a ordem em que cada um consegue a lock inanicao_m
+         vai ser a ordem de escrita no critico 
+
+        Assim evita ultrapassagem de um escritor por outro, porém não
+         trata starvation (inanição) entre escritores
+    */
+    trava(&mutex_m, TRAVA_MUTEX);
+
+    /* Fim sessão critica da variável locket_flag */
+    pthread_mutex_unlock(&inanicao_m);
+#endif
+
+#if MODO_LEITURA == MODO_INDICADORES
+    /* Novos leitores já veem a flag, aguarda os registrados saírem */
+    trava(&leitura_m, TRAVA_LEITURA);
+    while (leitores_ativos())
+        pthread_cond_wait(&saida_leitor_cond, &leitura_m);
+    pthread_mutex_unlock(&leitura_m);
+#elif MODO_LEITURA == MODO_SEQLOCK
+    /* Leitores não esperam, sequência ímpar invalida as leituras em andamento */
+    atomic_store_explicit(&sequencia, atomic_load_explicit(&sequencia, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+#elif MODO_LEITURA == MODO_RCU
+    /* Escreve em uma cópia, leitores seguem na versão atual até a publicação */
+    atomic_fetch_add(&escritas_ativas, 1);
+    if (!(rascunho = malloc(sizeof(tabela_t))))
+    {
+        perror("rcu: malloc");
+        abort();
+    }
+    memcpy(rascunho, atomic_load_explicit(&critico, memory_order_relaxed), sizeof(tabela_t));
+    return rascunho;
+#endif
+#if MODO_LEITURA == MODO_MUTEX
+    espera_registra(PAPEL_ESCRITOR, &espera_escritores[num - 1], inicio);
+#endif
+    return critico;
+}
+
+/* Saída do escritor 'num' da escrita */
+void sai_escrita(size_t num)
+{
+#if MODO_LEITURA == MODO_SEQLOCK
+    /* Sequência par de novo, publica a escrita */
+    atomic_store_explicit(&sequencia, atomic_load_explicit(&sequencia, memory_order_relaxed) + 1,
+                          memory_order_release);
+#elif MODO_LEITURA == MODO_RCU
+    /* Publica com uma troca do ponteiro, a versão antiga aguarda os leitores dela */
+    tabela_t *antiga = atomic_exchange(&critico, rascunho);
+    antiga->epoca = atomic_fetch_add(&epoca_global, 1);
+    antiga->prox = pendentes;
+    pendentes = antiga;
+    publicadas++;
+    if (++num_pendentes > pico_pendentes)
+        pico_pendentes = num_pendentes;
+    rcu_recolhe();
+    atomic_fetch_sub(&escritas_ativas, 1);
+    LOG("Versao publicada: %02ld (pendentes %ld, %ld bytes)\n", rascunho->versao, num_pendentes,
+        num_pendentes * sizeof(tabela_t));
+#endif
+#if POLITICA != POLITICA_ESCRITOR
+    politica_sai_escrita(num);
+#else
+    /* Fim sessão critica da variável critico */
+    pthread_mutex_unlock(&mutex_m);
+
+    /* Sessão critica da variavel locket_flag */
+    trava(&inanicao_m, TRAVA_INANICAO);
+    /*
+        Decrementa variável locket_flag, caso
+        seja o último escritor ativo, libera variável
+        condicional da mutex (Trava de novos leitores).
+    */
+    if (--locket_flag == 0)
+    {
+        /* Libera todos leitores esperando em fila */
+        pthread_cond_broadcast(&anti_inanicao_cond);
+    }
+    LOG("Fim do Escritor: %02ld\n", num);
+    /* Fim sessão critica da variável locket_flag */
+    pthread_mutex_unlock(&inanicao_m);
+#endif
+}
+
+/* Aplica uma escrita na tabela (pedido do escritor 'num') */
+void aplica_escrita(tabela_t *t, size_t chave, unsigned int valor, size_t num)
+{
+    t->valores[chave] = valor;
+    t->versao++;
+    if (sessao_ns)
+        carga_executa_ns(sessao_ns);
+    LOG("Escreve critico: %02ld [%02ld] versao %ld (%02ld)\n", valor, chave, t->versao, num);
+}
+
+#if COMBINACAO
+/* Pedido de escrita de cada escritor, uma linha de cache por escritor */
+typedef struct
+{
+    _Alignas(64) atomic_int pendente; /* Pedido aguardando um combinador */
+    size_t chave;
+    unsigned int valor;
+} publicacao_t;
+
+publicacao_t publicacoes[NUM_ESCR];
+pthread_mutex_t combinador_m;   /* Somente a vez do combinador, a escrita é fora dela */
+pthread_cond_t combinado_cond;  /* Fim de uma combinação */
+int combinando = 0;
+unsigned long combinacoes = 0, escritas_combinadas = 0, maior_combinacao = 0;
+
+/*
+    Combinador: uma única entrada na escrita aplica todos os pedidos
+    pendentes e publica uma vez, os leitores são barrados uma vez por
+    combinação e não por escrita. Os pedidos só são marcados como feitos
+    depois da publicação.
+*/
+void combina(size_t num)
+{
+    size_t aplicados[NUM_ESCR], n = 0, i;
+    tabela_t *t = entra_escrita(num);
+
+    for (i = 0; i < NUM_ESCR; i++)
+        if (atomic_load_explicit(&publicacoes[i].pendente, memory_order_acquire))
         {
-            /* Bloqueia escritores */
-            pthread_mutex_lock(&mutex_m);
+            aplica_escrita(t, publicacoes[i].chave, publicacoes[i].valor, i + 1);
+            aplicados[n++] = i;
         }
-        /* Fim sessão critica da variável num_leitores */
-        pthread_mutex_unlock(&leitura_m);
+    sai_escrita(num);
+
+    for (i = 0; i < n; i++)
+        atomic_store_explicit(&publicacoes[aplicados[i]].pendente, 0, memory_order_release);
+    LOG("Combinador: %02ld aplicou %ld escritas\n", num, n);
+    combinacoes++;
+    escritas_combinadas += n;
+    if (n > maior_combinacao)
+        maior_combinacao = n;
+}
+#endif
 
-        /* Simulando Leitura */
-        printf("Ler critico: %02d (%02ld)\n", critico, *(size_t *)num_thread);
+/* Escrita completa do escritor 'num' (entrada, alteração e saída) */
+void escreve_critico(size_t num, size_t chave, unsigned int valor)
+{
+#if COMBINACAO
+    publicacao_t *p = &publicacoes[num - 1];
+
+    /* Publica o pedido, o próprio escritor ou o combinador da vez aplica */
+    p->chave = chave;
+    p->valor = valor;
+    atomic_store_explicit(&p->pendente, 1, memory_order_release);
 
-        /* Sessão critica da variável num_leitores */
-        pthread_mutex_lock(&leitura_m);
-        /* Último leitor ativo ao sair libera os escritores */
-        if (--num_leitores == 0)
+    pthread_mutex_lock(&combinador_m);
+    while (atomic_load_explicit(&p->pendente, memory_order_acquire))
+    {
+        if (combinando)
         {
-            /* Destrava os escritores */
-            pthread_mutex_unlock(&mutex_m);
+            pthread_cond_wait(&combinado_cond, &combinador_m);
+            continue;
         }
-        /* Fim sessão critica da variável num_leitores */
-        pthread_mutex_unlock(&leitura_m);
+        /* Ninguém combinando e o pedido segue pendente, assume a vez */
+        combinando = 1;
+        pthread_mutex_unlock(&combinador_m);
+        combina(num);
+        pthread_mutex_lock(&combinador_m);
+        combinando = 0;
+        pthread_cond_broadcast(&combinado_cond);
     }
+    pthread_mutex_unlock(&combinador_m);
+#else
+    aplica_escrita(entra_escrita(num), chave, valor, num);
+    sai_escrita(num);
+#endif
+}
+
+/* Contadores do modo de leitura ao final (esperas por papel no mutex, seqlock e RCU) */
+void leitura_relatorio(void)
+{
+    size_t i;
+#if MODO_LEITURA == MODO_SEQLOCK
+    unsigned long leituras = 0, repeticoes = 0;
+    for (i = 0; i < NUM_LEIT; i++)
+    {
+        leituras += leitores_seq[i].leituras;
+        repeticoes += leitores_seq[i].repeticoes;
+    }
+    printf("Seqlock: leituras %lu, repeticoes %lu (%.2f%%)\n", leituras, repeticoes,
+           leituras ? 100.0 * repeticoes / leituras : 0.0);
+#elif MODO_LEITURA == MODO_RCU
+    static latencia_t durante, sem;
+    latencia_zera(&durante);
+    latencia_zera(&sem);
+    for (i = 0; i < NUM_LEIT; i++)
+    {
+        latencia_junta(&durante, &leitores_rcu[i].durante_escrita);
+        latencia_junta(&sem, &leitores_rcu[i].sem_escrita);
+    }
+    latencia_relatorio(&durante, "leitura durante escrita");
+    latencia_relatorio(&sem, "leitura sem escrita");
+    printf("RCU: versoes publicadas %zu, recolhidas %zu, pendentes %zu (%zu bytes), pico %zu (%zu bytes)\n",
+           publicadas, recolhidas, num_pendentes, num_pendentes * sizeof(tabela_t), pico_pendentes,
+           pico_pendentes * sizeof(tabela_t));
+#elif MODO_LEITURA == MODO_MUTEX
+    static latencia_t leitores, escritores;
+    latencia_zera(&leitores);
+    latencia_zera(&escritores);
+    for (i = 0; i < NUM_LEIT; i++)
+        latencia_junta(&leitores, &espera_leitores[i].espera);
+    for (i = 0; i < NUM_ESCR; i++)
+        latencia_junta(&escritores, &espera_escritores[i].espera);
+    latencia_relatorio(&leitores, "espera leitores");
+    latencia_relatorio(&escritores, "espera escritores");
+    printf("Politica %s: maior sequencia sem acesso, leitores %lu, escritores %lu aquisicoes\n",
+           nomes_politica[POLITICA], atomic_load(&maior_fome[PAPEL_LEITOR]),
+           atomic_load(&maior_fome[PAPEL_ESCRITOR]));
+#else
+    (void)i;
+#endif
+#if MODO_LEITURA == MODO_INDICADORES || (MODO_LEITURA == MODO_MUTEX && POLITICA == POLITICA_ESCRITOR)
+    printf("Leitores barrados pela locket_flag: %lu\n", atomic_load(&leitores_bloqueados));
+#endif
+#if COMBINACAO
+    printf("Combinacao: %lu escritas em %lu entradas (media %.2f, maior %lu)\n", escritas_combinadas,
+           combinacoes, combinacoes ? (double)escritas_combinadas / combinacoes : 0.0, maior_combinacao);
+#endif
+}
+
+
+void *leitor(void *num_thread)
+{
+    /* Gerador de carga dessa Thread (semente da execução + número da Thread) */
+    carga_t carga;
+    const tabela_t *t;
+    unsigned int valor, versao;
+    size_t chave;
+    carga_inicia(&carga, *(size_t *)num_thread);
+    RASTREIO_THREAD("leitor", *(size_t *)num_thread);
+    while (!atomic_load_explicit(&encerrar, memory_order_relaxed))
+    {
+        carga_servico(&carga, tempo_leit);
+
+        /* Consulta uma entrada da tabela, repete enquanto um escritor interferir (somente seqlock) */
+        chave = carga_intervalo(&carga, TAM_TABELA);
+        RASTREIO_INICIO("leitura");
+        do
+        {
+            t = entra_leitura(*(size_t *)num_thread);
+            /* Simulando Leitura */
+            valor = t->valores[chave];
+            versao = t->versao;
+            if (sessao_ns)
+                carga_executa_ns(sessao_ns);
+        } while (!sai_leitura(*(size_t *)num_thread));
+        RASTREIO_FIM("leitura");
+        LOG("Ler critico: %02ld [%02ld] versao %ld (%02ld)\n", valor, chave, versao, *(size_t *)num_thread);
+        conta(&leituras_feitas[*(size_t *)num_thread - 1]);
+    }
+    return NULL;
 }
 
 void *escritor(void *num_thread)
 {
-    /* Semente aleatória para essa Thread (horas menos múltiplos de 60) */
-    srand((size_t)time(NULL) - (*(size_t *)num_thread + 1) * 60);
-    while (1)
+    /* Gerador de carga dessa Thread (fluxos após os dos leitores) */
+    carga_t carga;
+    size_t chave;
+    carga_inicia(&carga, NUM_LEIT + *(size_t *)num_thread);
+    RASTREIO_THREAD("escritor", *(size_t *)num_thread);
+    while (!atomic_load_explicit(&encerrar, memory_order_relaxed))
     {
-        sleep((rand() % 3 + 1) * 100);
-
-        /* Sessão critica da variável locket_flag */
-        pthread_mutex_lock(&inanicao_m);
-        /*
-            Flag não binaria (0 == Falso, caso contrario é Verdadeiro)
-            Incrementa igualmente ao número de escritores ativos assim
-            leitores esperam até todos escritores deixar sessão critica.
-        */
-        printf("Novo Escritor: %02ld\n", *(size_t *)num_thread);
-        locket_flag++;
-
-        /* 
-            Sessão critica da variável critico 
-             Com essa lock dentro da lock do inanicao_m garantimos
-             que mais de um escritor pode entrar e travar os leitores
-             porém a ordem em que cada um consegue a lock inanicao_m
-             vai ser a ordem de escrita no critico 
-
-            Assim evita ultrapassagem de um escritor por outro, porém não
-             trata starvation (inanição) entre escritores
-        */
-        pthread_mutex_lock(&mutex_m);
-
-        /* Fim sessão critica da variável locket_flag */
-        pthread_mutex_unlock(&inanicao_m);
-        
-        /* Simula escrita com número aleatório de 1 a 100 */
-        critico = rand() % 99 + 1;
-        printf("Escreve critico: %02d (%02ld)\n", critico, *(size_t *)num_thread);
-        /* Fim sessão critica da variável critico */
-        pthread_mutex_unlock(&mutex_m);
+        carga_servico(&carga, tempo_escr);
+
+        /* Simula escrita com número aleatório de 1 a 100 em uma entrada da tabela */
+        chave = carga_intervalo(&carga, TAM_TABELA);
+        RASTREIO_INICIO("escrita");
+        escreve_critico(*(size_t *)num_thread, chave, carga_intervalo(&carga, 99) + 1);
+        RASTREIO_FIM("escrita");
+        conta(&escritas_feitas[*(size_t *)num_thread - 1]);
+    }
+    return NULL;
+}
+
+/*
+    Lê as variáveis EXECUCAO_* de ambiente: DURACAO (segundos) e OPERACOES
+    limitam a execução, LEITORES e ESCRITORES (até NUM_LEIT e NUM_ESCR),
+    LEITURA (fração das operações que são leituras, ajusta o intervalo dos
+    escritores) e SESSAO_US (tempo dentro de cada leitura e escrita).
+    Retorna -1 com LEITORES ou ESCRITORES fora do limite (mensagem no stderr).
+*/
+int execucao_configura(void)
+{
+    const char *v;
+    char *fim;
+    double fracao;
 
-        /* Sessão critica da variavel locket_flag */
-        pthread_mutex_lock(&inanicao_m);
-        /*
-            Decrementa variável locket_flag, caso
-            seja o último escritor ativo, libera variável
-            condicional da mutex (Trava de novos leitores).
-        */
-        if (--locket_flag == 0)
+    if ((v = getenv("EXECUCAO_DURACAO")))
+        duracao_s = strtod(v, NULL);
+    if ((v = getenv("EXECUCAO_OPERACOES")))
+        limite_operacoes = strtoul(v, NULL, 10);
+    if ((v = getenv("EXECUCAO_LEITORES")))
+    {
+        num_leit = strtoul(v, &fim, 10);
+        if (fim == v || *fim || num_leit > NUM_LEIT)
         {
-            /* Libera todos leitores esperando em fila */
-            pthread_cond_broadcast(&anti_inanicao_cond);
+            fprintf(stderr, "EXECUCAO_LEITORES invalido: '%s' (0..%d)\n", v, NUM_LEIT);
+            return -1;
         }
-        printf("Fim do Escritor: %02ld\n", *(size_t *)num_thread);
-        /* Fim sessão critica da variável locket_flag */
-        pthread_mutex_unlock(&inanicao_m);
+    }
+    if ((v = getenv("EXECUCAO_ESCRITORES")))
+    {
+        num_escr = strtoul(v, &fim, 10);
+        if (fim == v || *fim || num_escr > NUM_ESCR)
+        {
+            fprintf(stderr, "EXECUCAO_ESCRITORES invalido: '%s' (0..%d)\n", v, NUM_ESCR);
+            return -1;
+        }
+    }
+    if ((v = getenv("EXECUCAO_SESSAO_US")))
+        sessao_ns = strtoull(v, NULL, 10) * 1000;
+    /* Leituras por segundo = leitores / intervalo, escritas idem */
+    if ((v = getenv("EXECUCAO_LEITURA")) && (fracao = strtod(v, NULL)) > 0 && fracao < 1 && num_leit)
+        tempo_escr = (uint64_t)((double)tempo_leit * num_escr * fracao / (num_leit * (1 - fracao)));
+    return 0;
+}
+
+/* Soma das operações de todas as Threads */
+unsigned long operacoes_feitas(unsigned long *leituras, unsigned long *escritas)
+{
+    size_t i;
+    *leituras = *escritas = 0;
+    for (i = 0; i < num_leit; i++)
+        *leituras += atomic_load_explicit(&leituras_feitas[i].n, memory_order_relaxed);
+    for (i = 0; i < num_escr; i++)
+        *escritas += atomic_load_explicit(&escritas_feitas[i].n, memory_order_relaxed);
+    return *leituras + *escritas;
+}
+
+/* Aguarda o fim da duração ou do número de operações e pede o fim das Threads */
+void execucao_aguarda(uint64_t inicio)
+{
+    struct timespec intervalo = {0, 10000000};
+    unsigned long leituras, escritas;
+
+    while (1)
+    {
+        nanosleep(&intervalo, NULL);
+        if (duracao_s > 0 && carga_agora_ns() - inicio >= (uint64_t)(duracao_s * 1e9))
+            break;
+        if (limite_operacoes && operacoes_feitas(&leituras, &escritas) >= limite_operacoes)
+            break;
+    }
+    atomic_store(&encerrar, 1);
+}
+
+/* Vazão de leituras e escritas e espera em cada trava */
+void execucao_relatorio(uint64_t ns)
+{
+    unsigned long leituras, escritas;
+    double segundos = ns / 1e9;
+    char nome[32];
+    int i;
+
+    operacoes_feitas(&leituras, &escritas);
+    printf("Execucao: %.3f s, leituras %lu (%.1f/s), escritas %lu (%.1f/s)\n", segundos, leituras,
+           leituras / segundos, escritas, escritas / segundos);
+    for (i = 0; i < 3; i++)
+    {
+        snprintf(nome, sizeof(nome), "espera %s", nomes_trava[i]);
+        latencia_relatorio(&espera_travas[i], nome);
     }
 }
 
-int main(int argc, char const *argv[])
+int main(void)
 {
     /* Variável para iterações no FOR */
     size_t i;
     /* Threads de escritores e leitores */
     pthread_t esc_trd[NUM_ESCR], lei_trd[NUM_LEIT];
+    /* Atributos de afinidade de cada criação */
+    pthread_attr_t atributos;
     /* Enumerador das Threads */
     size_t num_esc[NUM_ESCR], num_lei[NUM_LEIT];
+    /* Início e fim da execução (vazão) */
+    uint64_t inicio, fim;
 
-    /* Semente aleatória (clock cpu) */
-    srand(time(NULL));
+    /* Semente e distribuição da carga (variáveis CARGA_* de ambiente) */
+    carga_configura();
+    /* Limites, Threads e proporção de leituras (variáveis EXECUCAO_* de ambiente) */
+    if (execucao_configura() < 0)
+        return 1;
+    /* Posicionamento das Threads (variável AFINIDADE), papéis na ordem de criação */
+    if (afinidade_configura(NULL) < 0)
+    {
+        fprintf(stderr, "AFINIDADE invalida: '%s'\n", getenv("AFINIDADE"));
+        return 1;
+    }
+    afinidade_papel(AFINIDADE_ESCRITOR, num_escr);
+    afinidade_papel(AFINIDADE_LEITOR, num_leit);
 
     /* Inicialização da Mutex e Mutex condicional */
     pthread_mutex_init(&leitura_m, NULL);
     pthread_mutex_init(&mutex_m, NULL);
     pthread_mutex_init(&inanicao_m, NULL);
+    /* Travas chegam ao perfil pelo ponteiro de trava() */
+    perfil_nomeia(&mutex_m, "mutex_m");
+    perfil_nomeia(&leitura_m, "leitura_m");
+    perfil_nomeia(&inanicao_m, "inanicao_m");
     pthread_cond_init(&anti_inanicao_cond, NULL);
+#if COMBINACAO
+    pthread_mutex_init(&combinador_m, NULL);
+    pthread_cond_init(&combinado_cond, NULL);
+#endif
+#if MODO_LEITURA == MODO_INDICADORES
+    pthread_cond_init(&saida_leitor_cond, NULL);
+#elif POLITICA != POLITICA_ESCRITOR
+    pthread_cond_init(&politica_cond, NULL);
+#elif MODO_LEITURA == MODO_RCU
+    /* Primeira versão alocada (todas as versões substituídas são liberadas) */
+    atomic_init(&critico, calloc(1, sizeof(tabela_t)));
+#endif
 
+    printf("Semente: %llu, distribuicao: %s\n", (unsigned long long)carga_semente,
+           carga_nome_distribuicao());
+    afinidade_relatorio();
+#if MODO_LEITURA == MODO_MUTEX
+    printf("Politica: %s\n", nomes_politica[POLITICA]);
+#endif
     printf("Comeco\n");
 
+    /* Escritor de fundo do log (antes das Threads) */
+    log_inicia();
+
     /* Inicialização das Threads (inicia condições de corrida) */
-    for (i = 0; i < NUM_ESCR; i++)
+    inicio = carga_agora_ns();
+    for (i = 0; i < num_escr; i++)
     {
         /* somente para enumerar cada Thread */
         num_esc[i] = i + 1;
-        pthread_create((esc_trd + i), NULL, (void *)&escritor, (void *)(num_esc + i));
+        pthread_create((esc_trd + i), afinidade_attr(&atributos, AFINIDADE_ESCRITOR, i),
+                       (void *)&escritor, (void *)(num_esc + i));
+        pthread_attr_destroy(&atributos);
     }
-    for (i = 0; i < NUM_LEIT; i++)
+    for (i = 0; i < num_leit; i++)
     {
         /* somente para enumerar cada Thread */
         num_lei[i] = i + 1;
-        pthread_create((lei_trd + i), NULL, (void *)&leitor, (void *)(num_lei + i));
+        pthread_create((lei_trd + i), afinidade_attr(&atributos, AFINIDADE_LEITOR, i),
+                       (void *)&leitor, (void *)(num_lei + i));
+        pthread_attr_destroy(&atributos);
     }
 
-    /* Aguardando Threads (NÃO ALCANÇÁVEIS NESSE EXEMPLO)*/
-    for (i = 0; i < NUM_ESCR; i++)
+    /* Execução limitada: pede o fim das Threads na duração ou no número de operações */
+    if (duracao_s > 0 || limite_operacoes)
+        execucao_aguarda(inicio);
+
+    /* Aguardando Threads (alcançáveis somente na execução limitada) */
+    for (i = 0; i < num_escr; i++)
         pthread_join(esc_trd[i], NULL);
-    for (i = 0; i < NUM_LEIT; i++)
+    for (i = 0; i < num_leit; i++)
         pthread_join(lei_trd[i], NULL);
+    fim = carga_agora_ns();
+
+    /* Escreve o restante do log (Threads já encerradas) */
+    log_finaliza();
+    execucao_relatorio(fim - inicio);
+    leitura_relatorio();
+    perfil_relatorio();
+    RASTREIO_EXPORTA();
+#if MODO_LEITURA == MODO_RCU
+    rcu_libera();
+#endif
 
-    printf("Fim\n"); /* Nunca será alcançável. */
+    printf("Fim\n"); /* Somente na execução limitada. */
 
     return 0;
 }
@@ -0,0 +1,213 @@
+/****************************************************************************
+ * Log assíncrono por thread, tira o printf (e a trava interna do stdio)    *
+ *  de dentro das sessões criticas dos programas de Threads.                *
+ *                                                                          *
+ * Cada thread grava registros binários de tamanho fixo (formato + até      *
+ *  LOG_MAX_ARGS argumentos inteiros) no seu próprio anel sem trava, um     *
+ *  único escritor e um único leitor. A thread de fundo (escritor do log)   *
+ *  recolhe os registros de todos os anéis, ordena pelo instante em que     *
+ *  foram gerados, formata e escreve em bloco na saída padrão.              *
+ *                                                                          *
+ * Uso: LOG("Produzindo: %02ld\n", valor); (argumentos convertidos para     *
+ *  'long', usar somente %ld/%lu/%lx e variações). O formato deve ser uma   *
+ *  string literal, somente o ponteiro é guardado.                          *
+ *  log_inicia() antes de criar as threads e log_finaliza() no fim, que     *
+ *  escreve o que restou.                                                   *
+ *                                                                          *
+ * Anel cheio descarta o registro (contado por anel e informado no          *
+ *  log_finaliza), quem registra nunca espera pelo escritor de fundo, nem   *
+ *  dentro de uma sessão critica.                                           *
+ *                                                                          *
+ * ** Compilação com -DSEM_LOG remove todo o log (LOG vira nada).           *
+ *************************************************************************** */
+
+#ifndef LOG_ASSINCRONO_H
+#define LOG_ASSINCRONO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#ifdef SEM_LOG
+
+/* Argumentos só dentro do sizeof (não avaliados), variáveis usadas somente no log não geram aviso */
+#define LOG(formato, ...) ((void)sizeof((long[]){__VA_ARGS__}))
+#define log_inicia()      ((void)0)
+#define log_finaliza()    ((void)0)
+
+#else
+
+/* Argumentos inteiros guardados por registro */
+#define LOG_MAX_ARGS    6
+/* Registros em cada anel (por thread) */
+#define LOG_TAM_ANEL    1024
+/* Registros recolhidos por passada do escritor de fundo */
+#define LOG_MAX_BLOCO   8192
+/* Intervalo do escritor de fundo quando não existe nada para escrever */
+#define LOG_INTERVALO_NS 1000000
+
+#define LOG(formato, ...) log_registra(formato, (long[LOG_MAX_ARGS]){__VA_ARGS__})
+
+/* Registro binário de tamanho fixo */
+typedef struct
+{
+    unsigned long long instante; /* Ordenação entre threads */
+    const char *formato;         /* String literal, não é copiada */
+    long args[LOG_MAX_ARGS];
+} log_registro_t;
+
+/* Anel de uma thread, 'cabeca' escrita pela dona e 'cauda' pelo escritor de fundo */
+typedef struct log_anel
+{
+    _Alignas(64) atomic_size_t cabeca;
+    _Alignas(64) atomic_size_t cauda;
+    atomic_size_t descartados; /* Registros perdidos com o anel cheio (escrito pela dona) */
+    struct log_anel *prox; /* Lista de anéis registrados */
+    log_registro_t registros[LOG_TAM_ANEL];
+} log_anel_t;
+
+static _Atomic(log_anel_t *) log_aneis = NULL;     /* Todos os anéis já criados */
+static _Thread_local log_anel_t *log_meu_anel = NULL;
+static pthread_t log_escritor;
+static atomic_int log_executando = 0;
+static log_registro_t log_bloco[LOG_MAX_BLOCO];    /* Usado somente pelo escritor de fundo */
+static char log_texto[LOG_MAX_BLOCO * 32];
+
+
+static inline unsigned long long log_agora(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/* Cria o anel da thread atual e o coloca na lista (uma vez por thread) */
+static inline log_anel_t *log_novo_anel(void)
+{
+    log_anel_t *anel = aligned_alloc(64, sizeof(log_anel_t));
+    atomic_init(&anel->cabeca, 0);
+    atomic_init(&anel->cauda, 0);
+    atomic_init(&anel->descartados, 0);
+    anel->prox = atomic_load(&log_aneis);
+    while (!atomic_compare_exchange_weak(&log_aneis, &anel->prox, anel))
+        ;
+    return log_meu_anel = anel;
+}
+
+static inline void log_registra(const char *formato, const long *args)
+{
+    log_anel_t *anel = log_meu_anel ? log_meu_anel : log_novo_anel();
+    size_t cabeca = atomic_load_explicit(&anel->cabeca, memory_order_relaxed);
+    log_registro_t *reg;
+
+    /* Anel cheio, descarta em vez de esperar o escritor de fundo (pode estar em sessão critica) */
+    if (cabeca - atomic_load_explicit(&anel->cauda, memory_order_acquire) == LOG_TAM_ANEL)
+    {
+        atomic_store_explicit(&anel->descartados,
+                              atomic_load_explicit(&anel->descartados, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        return;
+    }
+
+    reg = &anel->registros[cabeca % LOG_TAM_ANEL];
+    reg->instante = log_agora();
+    reg->formato = formato;
+    memcpy(reg->args, args, sizeof(reg->args));
+    /* Publica o registro para o escritor de fundo */
+    atomic_store_explicit(&anel->cabeca, cabeca + 1, memory_order_release);
+}
+
+static int log_compara(const void *a, const void *b)
+{
+    unsigned long long x = ((const log_registro_t *)a)->instante;
+    unsigned long long y = ((const log_registro_t *)b)->instante;
+    return (x > y) - (x < y);
+}
+
+/* Recolhe, ordena, formata e escreve os registros publicados, retorna quantos */
+static size_t log_descarrega(void)
+{
+    log_anel_t *anel;
+    size_t n = 0, i, len = 0, cauda, cabeca;
+    log_registro_t *r;
+
+    for (anel = atomic_load(&log_aneis); anel && n < LOG_MAX_BLOCO; anel = anel->prox)
+    {
+        cauda = atomic_load_explicit(&anel->cauda, memory_order_relaxed);
+        cabeca = atomic_load_explicit(&anel->cabeca, memory_order_acquire);
+        for (; cauda != cabeca && n < LOG_MAX_BLOCO; cauda++)
+            log_bloco[n++] = anel->registros[cauda % LOG_TAM_ANEL];
+        /* Libera os slots copiados para a thread dona */
+        atomic_store_explicit(&anel->cauda, cauda, memory_order_release);
+    }
+    if (!n)
+        return 0;
+
+    qsort(log_bloco, n, sizeof(log_registro_t), log_compara);
+    for (i = 0; i < n; i++)
+    {
+        r = &log_bloco[i];
+        /* Texto cheio, escreve o que já foi formatado */
+        if (sizeof(log_texto) - len < 256)
+        {
+            fwrite(log_texto, 1, len, stdout);
+            len = 0;
+        }
+        len += snprintf(log_texto + len, sizeof(log_texto) - len, r->formato,
+                        r->args[0], r->args[1], r->args[2], r->args[3], r->args[4], r->args[5]);
+        if (len > sizeof(log_texto))
+            len = sizeof(log_texto);
+    }
+    fwrite(log_texto, 1, len, stdout);
+    fflush(stdout);
+    return n;
+}
+
+/* Thread de fundo, escreve em bloco até log_finaliza() */
+static void *log_thread(void *arg)
+{
+    struct timespec intervalo = {0, LOG_INTERVALO_NS};
+    (void)arg;
+    while (atomic_load(&log_executando))
+    {
+        if (!log_descarrega())
+            nanosleep(&intervalo, NULL);
+    }
+    /* Escreve o que restou */
+    while (log_descarrega())
+        ;
+    return NULL;
+}
+
+static inline void log_inicia(void)
+{
+    atomic_store(&log_executando, 1);
+    pthread_create(&log_escritor, NULL, log_thread, NULL);
+}
+
+/* Encerra o escritor de fundo (após as threads que geram log terminarem) */
+static inline void log_finaliza(void)
+{
+    log_anel_t *anel, *prox;
+    size_t descartados = 0;
+
+    atomic_store(&log_executando, 0);
+    pthread_join(log_escritor, NULL);
+
+    for (anel = atomic_exchange(&log_aneis, NULL); anel; anel = prox)
+    {
+        prox = anel->prox;
+        descartados += atomic_load_explicit(&anel->descartados, memory_order_relaxed);
+        free(anel);
+    }
+    if (descartados)
+        printf("Log: %zu registros descartados (anel cheio)\n", descartados);
+}
+
+#endif /* SEM_LOG */
+
+#endif
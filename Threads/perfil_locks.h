@@ -0,0 +1,505 @@
+/****************************************************************************
+ * Perfil das travas dos programas de Threads: com -DPERFIL_LOCKS=1 as      *
+ *  chamadas de mutex, condicional e semáforo do programa passam por este   *
+ *  cabeçalho (macros com o mesmo nome), sem mudar o código do programa.    *
+ *  Sem a flag nada é definido e perfil_relatorio() não gera código.        *
+ *                                                                          *
+ * Por trava (nome do argumento na chamada, índices de vetor juntados em    *
+ *  '[]', ou o nome dado por perfil_nomeia): aquisições, aquisições         *
+ *  disputadas (trylock falhou), histograma da espera e da posse (da        *
+ *  aquisição até soltar, também na cond_wait). Condicional e semáforo      *
+ *  contam esperas, sinais e despertares inúteis (a mesma Thread volta a    *
+ *  esperar no mesmo objeto sem soltar a mutex, ou sem nenhum post no caso  *
+ *  do semáforo).                                                           *
+ *                                                                          *
+ * Contadores em tabelas por Thread (sem disputa entre Threads), somadas no *
+ *  relatório ao final, ordenado pela espera total.                         *
+ *                                                                          *
+ * ** Incluir depois de todos os outros cabeçalhos (travas internas do log, *
+ *    do controlador elástico e dos geradores não entram no perfil).        *
+ * ** Não combina com TAREFAS (as duas camadas redirecionam pthread_*).     *
+ * ** Histogramas por potência de 2 (percentil é o limite da faixa).        *
+ * ** Com -DRASTREIO=1 (mesmo sem PERFIL_LOCKS) as esperas bloqueantes e os *
+ *    sinais também vão para a linha do tempo de 'rastreio.h'.              *
+ *************************************************************************** */
+
+#ifndef PERFIL_LOCKS_H
+#define PERFIL_LOCKS_H
+
+#ifndef PERFIL_LOCKS
+#define PERFIL_LOCKS 0
+#endif
+
+#include "rastreio.h"
+
+#if PERFIL_LOCKS || RASTREIO
+
+#if defined(TAREFAS) && TAREFAS
+#error "perfil_locks.h: PERFIL_LOCKS e RASTREIO não combinam com TAREFAS"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+/* Objetos distintos que cada Thread acompanha (o excedente vai para "outros") */
+#define PERFIL_ENTRADAS  64
+/* Travas seguras ao mesmo tempo por uma Thread (posse medida) */
+#define PERFIL_POSSE     16
+/* Nomes dados por perfil_nomeia */
+#define PERFIL_NOMES     32
+/* Faixas do histograma (potências de 2 de nanosegundos) */
+#define PERFIL_FAIXAS    64
+
+#define PERFIL_TRAVA     0
+#define PERFIL_COND      1
+#define PERFIL_SEM       2
+
+typedef struct
+{
+    uint64_t faixa[PERFIL_FAIXAS];
+    uint64_t n, soma, max;
+} perfil_hist_t;
+
+typedef struct
+{
+    const void *objeto;
+    const char *nome;            /* Texto do argumento na primeira chamada */
+    int tipo;
+    uint64_t aquisicoes;         /* Travas pegas, esperas na condicional ou no semáforo */
+    uint64_t disputadas;         /* Não conseguiu de imediato */
+    uint64_t inuteis;            /* Despertares que voltaram a esperar */
+    uint64_t sinais;             /* signal, broadcast ou post */
+    perfil_hist_t espera, posse;
+} perfil_entrada_t;
+
+/* Tabela de uma Thread, escrita somente por ela */
+typedef struct perfil_thread
+{
+    perfil_entrada_t *entradas[PERFIL_ENTRADAS]; /* Alocadas no primeiro uso */
+    perfil_entrada_t outros;
+    struct
+    {
+        const void *trava;
+        perfil_entrada_t *entrada;
+        uint64_t inicio;
+    } posse[PERFIL_POSSE];
+    size_t num_posse;
+    const void *ultima_cond, *ultimo_sem; /* Última espera (despertar inútil) */
+    struct perfil_thread *prox;
+} perfil_thread_t;
+
+static _Thread_local perfil_thread_t *perfil_atual = NULL;
+static perfil_thread_t *perfil_threads = NULL; /* Todas as tabelas (registro_m) */
+static pthread_mutex_t perfil_registro_m = PTHREAD_MUTEX_INITIALIZER;
+static struct
+{
+    const void *objeto;
+    const char *nome;
+} perfil_nomes[PERFIL_NOMES];
+static size_t perfil_num_nomes = 0;
+
+
+static inline uint64_t perfil_agora(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+static inline void perfil_hist_registra(perfil_hist_t *h, uint64_t ns)
+{
+    h->faixa[ns ? 64 - __builtin_clzll(ns) - 1 : 0]++;
+    h->n++;
+    h->soma += ns;
+    if (ns > h->max)
+        h->max = ns;
+}
+
+static inline void perfil_hist_junta(perfil_hist_t *destino, const perfil_hist_t *origem)
+{
+    size_t i;
+    for (i = 0; i < PERFIL_FAIXAS; i++)
+        destino->faixa[i] += origem->faixa[i];
+    destino->n += origem->n;
+    destino->soma += origem->soma;
+    if (origem->max > destino->max)
+        destino->max = origem->max;
+}
+
+/* Percentil 'p' (0 a 1), limite superior da faixa limitado pelo máximo */
+static inline uint64_t perfil_hist_percentil(const perfil_hist_t *h, double p)
+{
+    uint64_t alvo = (uint64_t)(p * (double)h->n + 0.5), acumulado = 0, limite;
+    size_t i;
+
+    if (!h->n)
+        return 0;
+    if (alvo < 1)
+        alvo = 1;
+    for (i = 0; i < PERFIL_FAIXAS - 1; i++)
+        if ((acumulado += h->faixa[i]) >= alvo)
+            break;
+    limite = (2ull << i) - 1;
+    return limite < h->max ? limite : h->max;
+}
+
+/* Nome do objeto no relatório (chamar antes das Threads, ex. trava recebida por ponteiro) */
+static inline void perfil_nomeia(const void *objeto, const char *nome)
+{
+    if (perfil_num_nomes < PERFIL_NOMES)
+    {
+        perfil_nomes[perfil_num_nomes].objeto = objeto;
+        perfil_nomes[perfil_num_nomes++].nome = nome;
+    }
+}
+
+/* Nome dado por perfil_nomeia ou o texto do argumento */
+static inline const char *perfil_nome_objeto(const void *objeto, const char *nome)
+{
+    size_t i;
+    for (i = 0; i < perfil_num_nomes; i++)
+        if (perfil_nomes[i].objeto == objeto)
+            return perfil_nomes[i].nome;
+    return nome;
+}
+
+/* Espera (início e fim) ou sinal na linha do tempo */
+#if RASTREIO
+#define perfil_rastreia(objeto, nome, fase, categoria) \
+    rastreio_evento(perfil_nome_objeto((objeto), (nome)), (fase), (categoria))
+#else
+#define perfil_rastreia(objeto, nome, fase, categoria) ((void)0)
+#endif
+
+/* Tabela da Thread atual, criada e registrada na primeira chamada */
+static inline perfil_thread_t *perfil_thread(void)
+{
+    if (!perfil_atual)
+    {
+        if (!(perfil_atual = calloc(1, sizeof(perfil_thread_t))))
+        {
+            perror("perfil_locks: calloc");
+            abort();
+        }
+        perfil_atual->outros.nome = "outros";
+        pthread_mutex_lock(&perfil_registro_m);
+        perfil_atual->prox = perfil_threads;
+        perfil_threads = perfil_atual;
+        pthread_mutex_unlock(&perfil_registro_m);
+    }
+    return perfil_atual;
+}
+
+/* Entrada do objeto na tabela da Thread (endereçamento aberto pelo endereço) */
+static inline perfil_entrada_t *perfil_entrada(perfil_thread_t *t, const void *objeto, const char *nome,
+                                               int tipo)
+{
+    size_t i, k = ((uintptr_t)objeto >> 4) % PERFIL_ENTRADAS;
+
+    for (i = 0; i < PERFIL_ENTRADAS; i++, k = (k + 1) % PERFIL_ENTRADAS)
+    {
+        if (!t->entradas[k])
+        {
+            /* Sem memória o objeto é contado em "outros" */
+            if (!(t->entradas[k] = calloc(1, sizeof(perfil_entrada_t))))
+                return &t->outros;
+            t->entradas[k]->objeto = objeto;
+            t->entradas[k]->nome = nome;
+            t->entradas[k]->tipo = tipo;
+        }
+        if (t->entradas[k]->objeto == objeto)
+            return t->entradas[k];
+    }
+    return &t->outros;
+}
+
+/* Trava pega: começa a medir a posse */
+static inline void perfil_segura(perfil_thread_t *t, const void *trava, perfil_entrada_t *e)
+{
+    if (t->num_posse < PERFIL_POSSE)
+    {
+        t->posse[t->num_posse].trava = trava;
+        t->posse[t->num_posse].entrada = e;
+        t->posse[t->num_posse++].inicio = perfil_agora();
+    }
+}
+
+/* Trava solta: registra a posse, retorna a entrada (NULL se pega por outra Thread) */
+static inline perfil_entrada_t *perfil_solta(perfil_thread_t *t, const void *trava)
+{
+    perfil_entrada_t *e;
+    size_t i;
+
+    t->ultima_cond = NULL;
+    for (i = t->num_posse; i > 0; i--)
+    {
+        if (t->posse[i - 1].trava != trava)
+            continue;
+        e = t->posse[i - 1].entrada;
+        perfil_hist_registra(&e->posse, perfil_agora() - t->posse[i - 1].inicio);
+        t->posse[i - 1] = t->posse[--t->num_posse];
+        return e;
+    }
+    return NULL;
+}
+
+static inline int perfil_mutex_lock(pthread_mutex_t *m, const char *nome)
+{
+    perfil_thread_t *t = perfil_thread();
+    perfil_entrada_t *e = perfil_entrada(t, m, nome, PERFIL_TRAVA);
+    uint64_t inicio;
+    int r;
+
+    e->aquisicoes++;
+    if ((r = pthread_mutex_trylock(m)) == EBUSY)
+    {
+        e->disputadas++;
+        perfil_rastreia(m, nome, 'B', RASTREIO_ESPERA);
+        inicio = perfil_agora();
+        r = pthread_mutex_lock(m);
+        perfil_hist_registra(&e->espera, perfil_agora() - inicio);
+        perfil_rastreia(m, nome, 'E', RASTREIO_ESPERA);
+    }
+    else
+        perfil_hist_registra(&e->espera, 0);
+    /* EOWNERDEAD (mutex robusta) também entrega a trava */
+    if (r == 0 || r == EOWNERDEAD)
+        perfil_segura(t, m, e);
+    return r;
+}
+
+static inline int perfil_mutex_unlock(pthread_mutex_t *m)
+{
+    perfil_solta(perfil_thread(), m);
+    return pthread_mutex_unlock(m);
+}
+
+static inline int perfil_cond_wait(pthread_cond_t *c, pthread_mutex_t *m, const char *nome)
+{
+    perfil_thread_t *t = perfil_thread();
+    perfil_entrada_t *e = perfil_entrada(t, c, nome, PERFIL_COND), *trava;
+    uint64_t inicio;
+    int r;
+
+    /* Voltou a esperar sem soltar a mutex: o despertar anterior não tinha o que fazer */
+    if (t->ultima_cond == c)
+        e->inuteis++;
+    e->aquisicoes++;
+    trava = perfil_solta(t, m);
+    perfil_rastreia(c, nome, 'B', RASTREIO_ESPERA);
+    inicio = perfil_agora();
+    r = pthread_cond_wait(c, m);
+    perfil_hist_registra(&e->espera, perfil_agora() - inicio);
+    perfil_rastreia(c, nome, 'E', RASTREIO_ESPERA);
+    if (trava)
+        perfil_segura(t, m, trava);
+    t->ultima_cond = c;
+    return r;
+}
+
+static inline int perfil_cond_sinal(pthread_cond_t *c, const char *nome, int todos)
+{
+    perfil_thread_t *t = perfil_thread();
+    perfil_entrada(t, c, nome, PERFIL_COND)->sinais++;
+    perfil_rastreia(c, nome, 'i', RASTREIO_SINAL);
+    return todos ? pthread_cond_broadcast(c) : pthread_cond_signal(c);
+}
+
+/* Espera em um semáforo qualquer pelas funções de tentativa (0 em sucesso) e de espera */
+static inline int perfil_sem_espera(void *s, const char *nome, int (*tenta)(void *), int (*espera)(void *))
+{
+    perfil_thread_t *t = perfil_thread();
+    perfil_entrada_t *e = perfil_entrada(t, s, nome, PERFIL_SEM);
+    uint64_t inicio;
+    int r;
+
+    /* Outra espera no mesmo semáforo sem nenhum post no meio */
+    if (t->ultimo_sem == s)
+        e->inuteis++;
+    e->aquisicoes++;
+    if ((r = tenta(s)) != 0)
+    {
+        e->disputadas++;
+        perfil_rastreia(s, nome, 'B', RASTREIO_ESPERA);
+        inicio = perfil_agora();
+        r = espera(s);
+        perfil_hist_registra(&e->espera, perfil_agora() - inicio);
+        perfil_rastreia(s, nome, 'E', RASTREIO_ESPERA);
+    }
+    else
+        perfil_hist_registra(&e->espera, 0);
+    t->ultimo_sem = s;
+    return r;
+}
+
+static inline int perfil_sem_posix_tenta(void *s)
+{
+    return sem_trywait((sem_t *)s);
+}
+
+static inline int perfil_sem_posix_espera(void *s)
+{
+    return sem_wait((sem_t *)s);
+}
+
+static inline int perfil_sem_post(void *s, const char *nome)
+{
+    perfil_thread_t *t = perfil_thread();
+    perfil_entrada(t, s, nome, PERFIL_SEM)->sinais++;
+    perfil_rastreia(s, nome, 'i', RASTREIO_SINAL);
+    t->ultimo_sem = NULL;
+    return 0;
+}
+
+#ifdef FUTEX_SEM_H
+/* futex_sem_trywait retorna 1 em sucesso, convertido para a convenção do sem_trywait */
+static inline int perfil_futex_tenta(void *s)
+{
+    return futex_sem_trywait((futex_sem_t *)s) ? 0 : -1;
+}
+
+static inline int perfil_futex_espera(void *s)
+{
+    return futex_sem_wait((futex_sem_t *)s);
+}
+#endif
+
+/* Nome do relatório: dado por perfil_nomeia ou o argumento sem '&' e sem os índices */
+static inline void perfil_nome(const perfil_entrada_t *e, char *nome, size_t tam)
+{
+    const char *p = perfil_nome_objeto(e->objeto, e->nome);
+    size_t n = 0, profundidade = 0;
+
+    if (*p == '&')
+        p++;
+    for (; *p && n + 1 < tam; p++)
+    {
+        if (*p == '[' && profundidade++ == 0)
+            nome[n++] = '[';
+        else if (*p == ']' && --profundidade == 0)
+            nome[n++] = ']';
+        else if (!profundidade && *p != ' ')
+            nome[n++] = *p;
+    }
+    nome[n] = '\0';
+}
+
+static inline int perfil_compara(const void *a, const void *b)
+{
+    const perfil_entrada_t *x = a, *y = b;
+    return (y->espera.soma > x->espera.soma) - (y->espera.soma < x->espera.soma);
+}
+
+/* Junta as tabelas de todas as Threads por nome e imprime ordenado pela espera total */
+static inline void perfil_relatorio(void)
+{
+    static const char *tipos[] = {"mutex", "cond", "sem"};
+    perfil_entrada_t *total = NULL, *e, *novo_total;
+    char (*nomes)[64] = NULL, (*novos_nomes)[64], nome[64];
+    size_t num = 0, cap = 0, i, k;
+    perfil_thread_t *t;
+
+    pthread_mutex_lock(&perfil_registro_m);
+    for (t = perfil_threads; t; t = t->prox)
+    {
+        for (i = 0; i <= PERFIL_ENTRADAS; i++)
+        {
+            e = i < PERFIL_ENTRADAS ? t->entradas[i] : &t->outros;
+            if (!e || (!e->aquisicoes && !e->sinais))
+                continue;
+            perfil_nome(e, nome, sizeof(nome));
+            for (k = 0; k < num; k++)
+                if (total[k].tipo == e->tipo && !strcmp(nomes[k], nome))
+                    break;
+            if (k == num)
+            {
+                if (num == cap)
+                {
+                    cap = cap ? 2 * cap : 16;
+                    if ((novo_total = realloc(total, cap * sizeof(*total))))
+                        total = novo_total;
+                    if ((novos_nomes = realloc(nomes, cap * sizeof(*nomes))))
+                        nomes = novos_nomes;
+                    if (!novo_total || !novos_nomes)
+                    {
+                        pthread_mutex_unlock(&perfil_registro_m);
+                        perror("perfil_locks: realloc");
+                        free(total);
+                        free(nomes);
+                        return;
+                    }
+                }
+                memset(&total[num], 0, sizeof(*total));
+                total[num].tipo = e->tipo;
+                strcpy(nomes[num++], nome);
+            }
+            total[k].aquisicoes += e->aquisicoes;
+            total[k].disputadas += e->disputadas;
+            total[k].inuteis += e->inuteis;
+            total[k].sinais += e->sinais;
+            perfil_hist_junta(&total[k].espera, &e->espera);
+            perfil_hist_junta(&total[k].posse, &e->posse);
+        }
+    }
+    pthread_mutex_unlock(&perfil_registro_m);
+
+    printf("Perfil das travas (ordenado pela espera total):\n");
+    printf("%-28s %-5s %10s %10s %11s %9s %9s %9s %9s %8s %9s\n", "nome", "tipo", "aquisicoes",
+           "disputadas", "espera_ms", "esp_p99", "esp_max", "posse_p50", "posse_p99", "inuteis", "sinais");
+    /* Nenhuma trava usada pelo programa */
+    if (!num)
+        return;
+
+    /* Ordena os índices junto com os nomes (guarda o índice em 'objeto') */
+    for (k = 0; k < num; k++)
+        total[k].objeto = (const void *)(uintptr_t)k;
+    qsort(total, num, sizeof(*total), perfil_compara);
+
+    for (k = 0; k < num; k++)
+    {
+        e = &total[k];
+        printf("%-28s %-5s %10llu %10llu %11.3f %9.1f %9.1f %9.1f %9.1f %8llu %9llu\n",
+               nomes[(uintptr_t)e->objeto], tipos[e->tipo], (unsigned long long)e->aquisicoes,
+               (unsigned long long)e->disputadas, e->espera.soma / 1e6,
+               perfil_hist_percentil(&e->espera, 0.99) / 1e3, e->espera.max / 1e3,
+               perfil_hist_percentil(&e->posse, 0.50) / 1e3, perfil_hist_percentil(&e->posse, 0.99) / 1e3,
+               (unsigned long long)e->inuteis, (unsigned long long)e->sinais);
+    }
+    printf("(tempos em us, exceto espera_ms)\n");
+    free(total);
+    free(nomes);
+}
+
+/* Chamadas do programa passam pelo perfil (argumento como nome) */
+#define pthread_mutex_lock(m)      perfil_mutex_lock((m), #m)
+#define pthread_mutex_unlock(m)    perfil_mutex_unlock((m))
+#define pthread_cond_wait(c, m)    perfil_cond_wait((c), (m), #c)
+#define pthread_cond_signal(c)     perfil_cond_sinal((c), #c, 0)
+#define pthread_cond_broadcast(c)  perfil_cond_sinal((c), #c, 1)
+#define sem_wait(s)                perfil_sem_espera((s), #s, perfil_sem_posix_tenta, perfil_sem_posix_espera)
+#define sem_post(s)                (perfil_sem_post((s), #s), (sem_post)(s))
+#ifdef FUTEX_SEM_H
+#define futex_sem_wait(s)          perfil_sem_espera((s), #s, perfil_futex_tenta, perfil_futex_espera)
+#define futex_sem_post(s)          (perfil_sem_post((s), #s), (futex_sem_post)(s))
+#endif
+
+#if !PERFIL_LOCKS
+/* Somente o rastreio: camada ativa, sem relatório */
+#define perfil_relatorio()          ((void)0)
+#endif
+
+#else
+
+/* Perfil desligado: nada a medir */
+#define perfil_nomeia(objeto, nome) ((void)0)
+#define perfil_relatorio()          ((void)0)
+
+#endif
+
+#endif
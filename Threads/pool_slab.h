@@ -0,0 +1,230 @@
+/****************************************************************************
+ * Pool de blocos por thread (slab) para mensagens de tamanho variável,     *
+ *  o produtor preenche um bloco do seu próprio pool e coloca somente o     *
+ *  ponteiro (handle) na fila, sem copiar a mensagem e sem malloc por item. *
+ *                                                                          *
+ * Cada pool pertence a uma única thread (dona), que aloca sem trava das    *
+ *  listas livres locais de cada classe de tamanho (potências de 2, de      *
+ *  POOL_MIN_BLOCO a POOL_MAX_BLOCO). Os blocos vêm de slabs de             *
+ *  POOL_TAM_SLAB bytes alinhados ao próprio tamanho, assim o cabeçalho do  *
+ *  slab (pool dono e classe) é achado a partir do endereço do bloco.       *
+ *                                                                          *
+ * Outra thread devolve o bloco empilhando na lista remota do pool dono     *
+ *  (pilha sem trava, somente push), a dona recolhe a lista inteira de uma  *
+ *  vez (exchange, sem problema de ABA) quando a lista local esvazia.       *
+ *  Somente um novo slab chama o alocador do sistema.                       *
+ *                                                                          *
+ * Contadores: alocações, acertos (bloco reaproveitado das listas livres),  *
+ *  liberações locais e entre threads, slabs e pico de bytes em uso.        *
+ *                                                                          *
+ * ** O pool deve existir até todos os blocos serem devolvidos (inclusive   *
+ *    após a thread dona encerrar), pool_destroi() só depois dos joins.     *
+ *************************************************************************** */
+
+#ifndef POOL_SLAB_H
+#define POOL_SLAB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* Menor e maior classe de bloco (bits) */
+#define POOL_MIN_BITS       4
+#define POOL_MAX_BITS       14
+#define POOL_MIN_BLOCO      (1u << POOL_MIN_BITS)
+#define POOL_MAX_BLOCO      (1u << POOL_MAX_BITS)
+#define POOL_CLASSES        (POOL_MAX_BITS - POOL_MIN_BITS + 1)
+/* Tamanho (e alinhamento) de cada slab, cabem pelo menos 3 blocos da maior classe */
+#define POOL_TAM_SLAB       (4 * POOL_MAX_BLOCO)
+/* Cabeçalho do slab, os blocos começam após ele */
+#define POOL_CABECALHO      64
+
+/* Bloco livre, o primeiro campo do próprio bloco encadeia a lista */
+typedef struct pool_livre
+{
+    struct pool_livre *prox;
+} pool_livre_t;
+
+struct pool;
+
+/* Cabeçalho no início de cada slab */
+typedef struct pool_slab
+{
+    struct pool *dono;
+    struct pool_slab *prox; /* Slabs do pool (para pool_destroi) */
+    size_t classe;
+} pool_slab_t;
+
+typedef struct pool
+{
+    /* Usado somente pela thread dona */
+    pool_livre_t *livres[POOL_CLASSES]; /* Listas livres locais por classe */
+    pool_slab_t *atual[POOL_CLASSES];   /* Slab sendo repartido de cada classe */
+    size_t usados[POOL_CLASSES];        /* Blocos já repartidos do slab atual */
+    pool_slab_t *slabs;
+    unsigned long alocacoes, acertos, liberacoes_locais, num_slabs;
+    size_t pico_bytes;
+
+    /* Escrito pelas outras threads (em outra linha de cache) */
+    _Alignas(64) _Atomic(pool_livre_t *) remotos; /* Pilha de blocos devolvidos por outras threads */
+    atomic_ulong liberacoes_remotas;
+    atomic_size_t bytes_em_uso;
+} pool_t;
+
+
+static inline void pool_inicia(pool_t *p)
+{
+    size_t i;
+    for (i = 0; i < POOL_CLASSES; i++)
+    {
+        p->livres[i] = NULL;
+        p->atual[i] = NULL;
+        p->usados[i] = 0;
+    }
+    p->slabs = NULL;
+    p->alocacoes = p->acertos = p->liberacoes_locais = p->num_slabs = 0;
+    p->pico_bytes = 0;
+    atomic_init(&p->remotos, NULL);
+    atomic_init(&p->liberacoes_remotas, 0);
+    atomic_init(&p->bytes_em_uso, 0);
+}
+
+/* Libera todos os slabs (todos os blocos já devolvidos, nenhuma thread usando) */
+static inline void pool_destroi(pool_t *p)
+{
+    pool_slab_t *s, *prox;
+    for (s = p->slabs; s; s = prox)
+    {
+        prox = s->prox;
+        free(s);
+    }
+    p->slabs = NULL;
+}
+
+static inline size_t pool_classe(size_t tam)
+{
+    size_t c = 0;
+    while ((POOL_MIN_BLOCO << c) < tam)
+        c++;
+    return c;
+}
+
+static inline size_t pool_tam_classe(size_t classe)
+{
+    return (size_t)POOL_MIN_BLOCO << classe;
+}
+
+static inline pool_slab_t *pool_slab_de(void *bloco)
+{
+    return (pool_slab_t *)((uintptr_t)bloco & ~(uintptr_t)(POOL_TAM_SLAB - 1));
+}
+
+/* Capacidade do bloco (tamanho da sua classe) */
+static inline size_t pool_capacidade(void *bloco)
+{
+    return pool_tam_classe(pool_slab_de(bloco)->classe);
+}
+
+/* Recolhe os blocos devolvidos por outras threads para as listas locais */
+static inline void pool_recolhe_remotos(pool_t *p)
+{
+    pool_livre_t *b = atomic_exchange_explicit(&p->remotos, NULL, memory_order_acquire), *prox;
+    size_t c;
+    for (; b; b = prox)
+    {
+        prox = b->prox;
+        c = pool_slab_de(b)->classe;
+        b->prox = p->livres[c];
+        p->livres[c] = b;
+    }
+}
+
+/* Aloca um bloco de pelo menos 'tam' bytes (somente a thread dona), NULL se 'tam' > POOL_MAX_BLOCO
+ * ou sem memória para um novo slab */
+static inline void *pool_aloca(pool_t *p, size_t tam)
+{
+    size_t c, bytes;
+    pool_livre_t *b;
+    pool_slab_t *s;
+
+    if (tam > POOL_MAX_BLOCO)
+        return NULL;
+    c = pool_classe(tam);
+
+    /* Lista local vazia, tenta os devolvidos pelas outras threads */
+    if (!p->livres[c] && atomic_load_explicit(&p->remotos, memory_order_relaxed))
+        pool_recolhe_remotos(p);
+    if ((b = p->livres[c]))
+    {
+        /* Acerto, bloco reaproveitado */
+        p->livres[c] = b->prox;
+        p->acertos++;
+    }
+    else
+    {
+        /* Reparte o slab atual da classe, ou pede um novo ao sistema */
+        s = p->atual[c];
+        if (!s || POOL_CABECALHO + (p->usados[c] + 1) * pool_tam_classe(c) > POOL_TAM_SLAB)
+        {
+            s = aligned_alloc(POOL_TAM_SLAB, POOL_TAM_SLAB);
+            if (!s)
+                return NULL;
+            s->dono = p;
+            s->classe = c;
+            s->prox = p->slabs;
+            p->slabs = s;
+            p->atual[c] = s;
+            p->usados[c] = 0;
+            p->num_slabs++;
+        }
+        b = (pool_livre_t *)((char *)s + POOL_CABECALHO + p->usados[c]++ * pool_tam_classe(c));
+    }
+
+    /* Contadores somente com o bloco em mãos */
+    p->alocacoes++;
+    bytes = atomic_fetch_add_explicit(&p->bytes_em_uso, pool_tam_classe(c), memory_order_relaxed) +
+            pool_tam_classe(c);
+    if (bytes > p->pico_bytes)
+        p->pico_bytes = bytes;
+    return b;
+}
+
+/*
+    Devolve o bloco ao pool dono. 'atual' é o pool da thread que libera
+    (NULL caso ela não tenha pool): sendo o dono vai para a lista local,
+    senão para a pilha remota do dono.
+*/
+static inline void pool_libera(pool_t *atual, void *bloco)
+{
+    pool_slab_t *s = pool_slab_de(bloco);
+    pool_t *dono = s->dono;
+    pool_livre_t *b = (pool_livre_t *)bloco;
+
+    atomic_fetch_sub_explicit(&dono->bytes_em_uso, pool_tam_classe(s->classe), memory_order_relaxed);
+    if (dono == atual)
+    {
+        b->prox = dono->livres[s->classe];
+        dono->livres[s->classe] = b;
+        dono->liberacoes_locais++;
+        return;
+    }
+
+    b->prox = atomic_load_explicit(&dono->remotos, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&dono->remotos, &b->prox, b,
+                                                  memory_order_release, memory_order_relaxed))
+        ;
+    atomic_fetch_add_explicit(&dono->liberacoes_remotas, 1, memory_order_relaxed);
+}
+
+/* Imprime os contadores do pool */
+static inline void pool_relatorio(pool_t *p, const char *nome)
+{
+    printf("Pool %s: alocacoes %lu, acertos %lu, liberacoes locais %lu, entre threads %lu, "
+           "slabs %lu (%lu KiB), pico em uso %lu bytes\n",
+           nome, p->alocacoes, p->acertos, p->liberacoes_locais,
+           atomic_load(&p->liberacoes_remotas), p->num_slabs,
+           p->num_slabs * (POOL_TAM_SLAB / 1024), (unsigned long)p->pico_bytes);
+}
+
+#endif
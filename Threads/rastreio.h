@@ -0,0 +1,245 @@
+/****************************************************************************
+ * Rastreio da linha do tempo dos programas de Threads: com -DRASTREIO=1    *
+ *  cada Thread grava eventos de início e fim (produz, consome, leitura,    *
+ *  escrita, come, pensa) e as esperas bloqueantes e sinais das travas      *
+ *  (pelas chamadas redirecionadas de 'perfil_locks.h') no próprio vetor,   *
+ *  sem trava. rastreio_exporta() junta tudo no formato trace-event do      *
+ *  Chrome (JSON), aberto sem rede no Perfetto (ui.perfetto.dev) ou em      *
+ *  chrome://tracing: comboios e cadeias de despertar aparecem por Thread.  *
+ *                                                                          *
+ * Cada evento custa uma leitura do relógio monotônico e uma escrita no     *
+ *  vetor da Thread. Vetor cheio descarta os eventos seguintes (contados no *
+ *  final) mantendo os fins dos trechos já abertos. Arquivo na variável     *
+ *  RASTREIO_ARQUIVO (padrão 'rastreio.json').                              *
+ *                                                                          *
+ * Sem a flag as macros RASTREIO_* não geram código.                        *
+ *                                                                          *
+ * ** Não combina com TAREFAS (tarefas trocam de Thread no meio do trecho). *
+ *************************************************************************** */
+
+#ifndef RASTREIO_H
+#define RASTREIO_H
+
+#ifndef RASTREIO
+#define RASTREIO 0
+#endif
+
+#if RASTREIO
+
+#if defined(TAREFAS) && TAREFAS
+#error "rastreio.h: RASTREIO não combina com TAREFAS"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Eventos guardados por Thread */
+#ifndef RASTREIO_EVENTOS
+#define RASTREIO_EVENTOS  (1u << 16)
+#endif
+/* Espaço guardado para os fins dos trechos abertos quando o vetor enche */
+#define RASTREIO_RESERVA  64
+
+/* Categorias dos eventos */
+#define RASTREIO_TRABALHO 0
+#define RASTREIO_ESPERA   1
+#define RASTREIO_SINAL    2
+
+typedef struct
+{
+    uint64_t ts;
+    const char *nome;
+    char fase;          /* 'B' início, 'E' fim, 'i' instante */
+    char categoria;
+} rastreio_evento_t;
+
+/* Vetor de uma Thread, escrito somente por ela */
+typedef struct rastreio_thread
+{
+    rastreio_evento_t *eventos;
+    size_t n, abertos;
+    size_t ignorados;   /* Inícios descartados, os fins correspondentes também são */
+    unsigned long descartados;
+    const char *papel;
+    size_t num, tid;
+    struct rastreio_thread *prox;
+} rastreio_thread_t;
+
+static _Thread_local rastreio_thread_t *rastreio_atual = NULL;
+static rastreio_thread_t *rastreio_threads = NULL; /* Todas as Threads (registro_m) */
+static size_t rastreio_num_threads = 0;
+static pthread_mutex_t rastreio_registro_m = PTHREAD_MUTEX_INITIALIZER;
+
+
+static inline uint64_t rastreio_agora(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/* Vetor da Thread atual, criado e registrado no primeiro evento */
+static inline rastreio_thread_t *rastreio_thread(void)
+{
+    if (!rastreio_atual)
+    {
+        if (!(rastreio_atual = calloc(1, sizeof(rastreio_thread_t))) ||
+            !(rastreio_atual->eventos = malloc(RASTREIO_EVENTOS * sizeof(rastreio_evento_t))))
+        {
+            perror("rastreio: malloc");
+            abort();
+        }
+        pthread_mutex_lock(&rastreio_registro_m);
+        rastreio_atual->tid = ++rastreio_num_threads;
+        rastreio_atual->prox = rastreio_threads;
+        rastreio_threads = rastreio_atual;
+        pthread_mutex_unlock(&rastreio_registro_m);
+    }
+    return rastreio_atual;
+}
+
+static inline void rastreio_evento(const char *nome, char fase, char categoria)
+{
+    rastreio_thread_t *t = rastreio_thread();
+    rastreio_evento_t *e;
+
+    if (fase == 'E')
+    {
+        /* Fim de um início descartado */
+        if (t->ignorados)
+        {
+            t->ignorados--;
+            return;
+        }
+        t->abertos--;
+    }
+    else if (t->n + RASTREIO_RESERVA >= RASTREIO_EVENTOS)
+    {
+        t->descartados++;
+        if (fase == 'B')
+            t->ignorados++;
+        return;
+    }
+    else if (fase == 'B')
+        t->abertos++;
+
+    e = &t->eventos[t->n++];
+    e->ts = rastreio_agora();
+    e->nome = nome;
+    e->fase = fase;
+    e->categoria = categoria;
+}
+
+/* Nome da Thread no visualizador ("papel num") */
+static inline void rastreio_nome_thread(const char *papel, size_t num)
+{
+    rastreio_thread_t *t = rastreio_thread();
+    t->papel = papel;
+    t->num = num;
+}
+
+/* Nome sem '&', índices de vetor juntados em '[]' e aspas escapadas */
+static inline void rastreio_escreve_nome(FILE *f, const char *prefixo, const char *nome)
+{
+    size_t profundidade = 0;
+
+    fputs(prefixo, f);
+    if (*nome == '&')
+        nome++;
+    for (; *nome; nome++)
+    {
+        if (*nome == '[' && profundidade++ == 0)
+            fputc('[', f);
+        else if (*nome == ']' && --profundidade == 0)
+            fputc(']', f);
+        else if (!profundidade && *nome != ' ')
+        {
+            if (*nome == '"' || *nome == '\\')
+                fputc('\\', f);
+            fputc(*nome, f);
+        }
+    }
+}
+
+/* Escreve todos os eventos (Threads já encerradas) no formato trace-event do Chrome */
+static inline void rastreio_exporta_arquivo(const char *arquivo)
+{
+    static const char *categorias[] = {"trabalho", "espera", "sinal"};
+    static const char *prefixos[] = {"", "espera ", "sinal "};
+    uint64_t inicio = UINT64_MAX;
+    unsigned long total = 0, descartados = 0;
+    rastreio_thread_t *t;
+    rastreio_evento_t *e;
+    FILE *f;
+    size_t i;
+    int primeiro = 1;
+
+    if (!(f = fopen(arquivo, "w")))
+    {
+        perror(arquivo);
+        return;
+    }
+
+    pthread_mutex_lock(&rastreio_registro_m);
+    /* Tempos relativos ao primeiro evento */
+    for (t = rastreio_threads; t; t = t->prox)
+        if (t->n && t->eventos[0].ts < inicio)
+            inicio = t->eventos[0].ts;
+
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for (t = rastreio_threads; t; t = t->prox)
+    {
+        if (t->papel)
+        {
+            fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %zu, "
+                       "\"args\": {\"name\": \"%s %02zu\"}}",
+                    primeiro ? "" : ",\n", (int)getpid(), t->tid, t->papel, t->num);
+            primeiro = 0;
+        }
+        for (i = 0; i < t->n; i++)
+        {
+            e = &t->eventos[i];
+            fprintf(f, "%s{\"name\": \"", primeiro ? "" : ",\n");
+            rastreio_escreve_nome(f, prefixos[(int)e->categoria], e->nome);
+            fprintf(f, "\", \"cat\": \"%s\", \"ph\": \"%c\", %s\"ts\": %.3f, \"pid\": %d, \"tid\": %zu}",
+                    categorias[(int)e->categoria], e->fase, e->fase == 'i' ? "\"s\": \"t\", " : "",
+                    (e->ts - inicio) / 1e3, (int)getpid(), t->tid);
+            primeiro = 0;
+        }
+        total += t->n;
+        descartados += t->descartados;
+    }
+    fprintf(f, "\n]}\n");
+    pthread_mutex_unlock(&rastreio_registro_m);
+    fclose(f);
+
+    printf("Rastreio: %lu eventos de %zu Threads em '%s' (%lu descartados)\n", total,
+           rastreio_num_threads, arquivo, descartados);
+}
+
+static inline void rastreio_exporta(void)
+{
+    const char *arquivo = getenv("RASTREIO_ARQUIVO");
+    rastreio_exporta_arquivo(arquivo ? arquivo : "rastreio.json");
+}
+
+#define RASTREIO_INICIO(nome)       rastreio_evento((nome), 'B', RASTREIO_TRABALHO)
+#define RASTREIO_FIM(nome)          rastreio_evento((nome), 'E', RASTREIO_TRABALHO)
+#define RASTREIO_THREAD(papel, num) rastreio_nome_thread((papel), (num))
+#define RASTREIO_EXPORTA()          rastreio_exporta()
+
+#else
+
+/* Rastreio desligado: nada a gravar */
+#define RASTREIO_INICIO(nome)       ((void)0)
+#define RASTREIO_FIM(nome)          ((void)0)
+#define RASTREIO_THREAD(papel, num) ((void)0)
+#define RASTREIO_EXPORTA()          ((void)0)
+
+#endif
+
+#endif
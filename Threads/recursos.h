@@ -0,0 +1,167 @@
+/****************************************************************************
+ * Gerenciador de recursos sem deadlock para os programas de Threads: uma   *
+ *  tarefa pede um conjunto qualquer de recursos (índices de 0 a num - 1) e *
+ *  recebe todos, como os dois hashis do filosofo mas sem a forma de anel.  *
+ *                                                                          *
+ * O pedido é ordenado (e sem repetidos) e os recursos são pegos do menor   *
+ *  índice para o maior, a ordem global impede o ciclo de espera. Cada      *
+ *  recurso tem a própria trava e a própria fila por bilhetes (ordem de     *
+ *  chegada), sem trava global: pedidos sem recursos em comum nunca         *
+ *  disputam nada.                                                          *
+ *                                                                          *
+ * Contadores por recurso (aquisições e quantas precisaram esperar na       *
+ *  fila) ficam sob a trava do recurso e são somados no relatório.          *
+ *                                                                          *
+ * ** Com TAREFAS incluir 'tarefas.h' antes, a espera na fila estaciona     *
+ *    somente a tarefa.                                                     *
+ *************************************************************************** */
+
+#ifndef RECURSOS_H
+#define RECURSOS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Fila de um recurso, uma linha de cache por recurso */
+typedef struct
+{
+    _Alignas(64) pthread_mutex_t trava; /* Protege somente a fila deste recurso */
+    pthread_cond_t vez_cond;            /* Aguarda a vez do bilhete */
+    unsigned long proximo;              /* Próximo bilhete entregue */
+    unsigned long vez;                  /* Bilhete do dono atual */
+    unsigned long aquisicoes, esperas;  /* Contadores do recurso */
+} recurso_t;
+
+typedef struct
+{
+    recurso_t *recursos;
+    size_t num;
+} recursos_t;
+
+
+/* Cria 'num' recursos livres, retorna 0 ou -1 sem memória (ou sem recursos) */
+static inline int recursos_inicia(recursos_t *g, size_t num)
+{
+    size_t i;
+
+    if (!num || num > SIZE_MAX / sizeof(recurso_t))
+        return -1;
+    g->recursos = aligned_alloc(64, num * sizeof(recurso_t));
+    if (!g->recursos)
+        return -1;
+    g->num = num;
+    for (i = 0; i < num; i++)
+    {
+        pthread_mutex_init(&g->recursos[i].trava, NULL);
+        pthread_cond_init(&g->recursos[i].vez_cond, NULL);
+        g->recursos[i].proximo = g->recursos[i].vez = 0;
+        g->recursos[i].aquisicoes = g->recursos[i].esperas = 0;
+    }
+    return 0;
+}
+
+static inline void recursos_destroi(recursos_t *g)
+{
+    size_t i;
+    for (i = 0; i < g->num; i++)
+    {
+        pthread_mutex_destroy(&g->recursos[i].trava);
+        pthread_cond_destroy(&g->recursos[i].vez_cond);
+    }
+    free(g->recursos);
+}
+
+/* Ordena 'ids' (inserção, conjuntos pequenos) e remove repetidos, retorna quantos ficaram */
+static inline size_t recursos_ordena(size_t *ids, size_t n)
+{
+    size_t i, j, k, id;
+
+    for (i = 1; i < n; i++)
+    {
+        id = ids[i];
+        for (j = i; j > 0 && ids[j - 1] > id; j--)
+            ids[j] = ids[j - 1];
+        ids[j] = id;
+    }
+    for (i = k = 0; i < n; i++)
+        if (k == 0 || ids[i] != ids[k - 1])
+            ids[k++] = ids[i];
+    return k;
+}
+
+/* Entra na fila do recurso e aguarda a vez */
+static inline void recursos_pega_um(recurso_t *r)
+{
+    unsigned long bilhete;
+
+    pthread_mutex_lock(&r->trava);
+    bilhete = r->proximo++;
+    r->aquisicoes++;
+    if (r->vez != bilhete)
+    {
+        r->esperas++;
+        while (r->vez != bilhete)
+            pthread_cond_wait(&r->vez_cond, &r->trava);
+    }
+    pthread_mutex_unlock(&r->trava);
+}
+
+/* Passa a vez ao próximo bilhete, acorda a fila somente se existir alguém nela */
+static inline void recursos_devolve_um(recurso_t *r)
+{
+    pthread_mutex_lock(&r->trava);
+    r->vez++;
+    if (r->proximo != r->vez)
+        pthread_cond_broadcast(&r->vez_cond);
+    pthread_mutex_unlock(&r->trava);
+}
+
+/*
+    Pega todos os recursos de 'ids' em ordem crescente. 'ids' é ordenado e
+    perde os repetidos no lugar, retorna quantos ficaram (passar os mesmos
+    para recursos_devolve) ou 0 sem pegar nada caso algum índice seja inválido.
+*/
+static inline size_t recursos_pega(recursos_t *g, size_t *ids, size_t n)
+{
+    size_t i;
+
+    n = recursos_ordena(ids, n);
+    if (n && ids[n - 1] >= g->num)
+        return 0;
+    for (i = 0; i < n; i++)
+        recursos_pega_um(&g->recursos[ids[i]]);
+    return n;
+}
+
+/* Devolve os recursos de um pedido (saída de recursos_pega) */
+static inline void recursos_devolve(recursos_t *g, const size_t *ids, size_t n)
+{
+    size_t i;
+    for (i = n; i > 0; i--)
+        recursos_devolve_um(&g->recursos[ids[i - 1]]);
+}
+
+/* Soma os contadores de todos os recursos (sem pedidos em andamento) */
+static inline void recursos_totais(recursos_t *g, unsigned long *aquisicoes, unsigned long *esperas)
+{
+    size_t i;
+    *aquisicoes = *esperas = 0;
+    for (i = 0; i < g->num; i++)
+    {
+        *aquisicoes += g->recursos[i].aquisicoes;
+        *esperas += g->recursos[i].esperas;
+    }
+}
+
+static inline void recursos_relatorio(recursos_t *g, const char *nome)
+{
+    unsigned long aquisicoes, esperas;
+
+    recursos_totais(g, &aquisicoes, &esperas);
+    printf("Recursos %s: %zu, aquisicoes %lu, esperas na fila %lu (%.1f%%)\n", nome, g->num,
+           aquisicoes, esperas, aquisicoes ? 100.0 * esperas / aquisicoes : 0.0);
+}
+
+#endif
@@ -0,0 +1,663 @@
+/****************************************************************************
+ * Tarefas M:N para os programas de Threads: cada produtor, consumidor,     *
+ *  leitor, escritor ou filósofo vira uma tarefa (corrotina com pilha       *
+ *  própria, ucontext) e poucas Threads do sistema (trabalhadores) executam *
+ *  todas, assim dezenas de milhares de atores não custam dezenas de        *
+ *  milhares de pilhas de Thread e trocas de contexto no kernel.            *
+ *                                                                          *
+ * Trava, condicional, semáforo, join e espera por tempo estacionam somente *
+ *  a tarefa (a Thread do trabalhador segue com a próxima pronta). Tarefas  *
+ *  prontas ficam em uma fila única e as que dormem em um heap por prazo,   *
+ *  trabalhadores sem tarefa dormem até a próxima pronta ou o menor prazo.  *
+ *  Fora de uma tarefa (main) as mesmas funções bloqueiam a Thread.         *
+ *                                                                          *
+ * Uso: incluir após os cabeçalhos que criam Threads do sistema (log) e     *
+ *  antes dos que devem estacionar a tarefa ('carga.h'). O final deste      *
+ *  arquivo redireciona pthread_create/join/exit, mutex, condicional,       *
+ *  sem_t e clock_nanosleep para as versões das tarefas, o programa não     *
+ *  muda. Trabalhadores: TAREFAS_TRABALHADORES (compilação ou ambiente),    *
+ *  padrão um por CPU.                                                      *
+ *                                                                          *
+ * ** Espera ocupando a CPU (CARGA_ESPERA=ocupar), futex e giro seguram o   *
+ *    trabalhador inteiro. Variáveis _Thread_local são do trabalhador.      *
+ *************************************************************************** */
+
+#ifndef TAREFAS_H
+#define TAREFAS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <ucontext.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <stdatomic.h>
+
+/* Trabalhadores (Threads do sistema) que executam as tarefas, 0 = um por CPU */
+#ifndef TAREFAS_TRABALHADORES
+#define TAREFAS_TRABALHADORES 0
+#endif
+/* Pilha de cada tarefa em bytes (mais uma página de guarda) */
+#ifndef TAREFAS_TAM_PILHA
+#define TAREFAS_TAM_PILHA   (64 * 1024)
+#endif
+
+/* Estado da tarefa */
+#define TAREFA_PRONTA       0
+#define TAREFA_EXECUTANDO   1
+#define TAREFA_PARADA       2 /* Estacionada (trava, condicional, semáforo, join ou tempo) */
+#define TAREFA_TERMINADA    3
+
+/* Ação do trabalhador logo após a tarefa sair da CPU (contexto já salvo) */
+#define TAREFA_ACAO_LIBERA  0 /* Libera a guarda da estrutura onde a tarefa estacionou */
+#define TAREFA_ACAO_DORME   1 /* Coloca a tarefa no heap por prazo */
+#define TAREFA_ACAO_TERMINA 2 /* Marca o fim e acorda quem aguarda o join */
+
+struct tarefa_espera;
+
+typedef struct tarefa
+{
+    ucontext_t contexto;
+    void *(*funcao)(void *);
+    void *arg, *retorno;
+    char *pilha;                  /* Início do mapeamento (página de guarda) */
+    int estado;
+    uint64_t prazo;               /* Fim da espera por tempo */
+    struct tarefa *prox;          /* Fila de prontas */
+    struct tarefa_espera *junta;  /* Quem aguarda o fim da tarefa */
+} tarefa_t;
+
+/* Identificador no lugar do pthread_t */
+typedef tarefa_t *tarefa_id_t;
+
+/* Registro de quem espera em uma trava, condicional, semáforo ou join (na pilha de quem espera) */
+typedef struct tarefa_espera
+{
+    struct tarefa_espera *prox;
+    tarefa_t *tarefa; /* Tarefa estacionada, NULL para uma Thread do sistema (main) */
+    sem_t sinal;      /* Somente Thread do sistema */
+} tarefa_espera_t;
+
+/* Fila FIFO de esperas */
+typedef struct
+{
+    tarefa_espera_t *primeiro, *ultimo;
+} tarefa_fila_t;
+
+typedef struct
+{
+    pthread_mutex_t guarda; /* Protege os campos, nunca fica presa durante a espera */
+    int travada;
+    tarefa_fila_t espera;
+} tarefa_mutex_t;
+
+typedef struct
+{
+    pthread_mutex_t guarda;
+    tarefa_fila_t espera;
+} tarefa_cond_t;
+
+typedef struct
+{
+    pthread_mutex_t guarda;
+    unsigned int valor;
+    tarefa_fila_t espera;
+} tarefa_sem_t;
+
+/* Trabalhador, 'contexto' é o laço de escalonamento na pilha da Thread */
+typedef struct
+{
+    ucontext_t contexto;
+    tarefa_t *atual;
+    int acao;
+    pthread_mutex_t *guarda;
+} tarefa_trabalhador_t;
+
+static pthread_once_t tarefas_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t tarefas_trava = PTHREAD_MUTEX_INITIALIZER; /* Prontas, dormindo e joins */
+static pthread_cond_t tarefas_cond;                               /* Trabalhadores sem tarefa */
+static tarefa_t *tarefas_prontas = NULL, *tarefas_ultima = NULL;
+static tarefa_t **tarefas_dormindo = NULL;                        /* Heap mínimo por prazo */
+static size_t tarefas_num_dormindo = 0, tarefas_cap_dormindo = 0;
+static size_t tarefas_num_trab = 0, tarefas_pagina = 0;
+static size_t tarefas_criadas = 0, tarefas_vivas = 0, tarefas_pico = 0;
+static atomic_ulong tarefas_trocas = 0;                           /* Entradas de tarefas na CPU */
+static _Thread_local tarefa_trabalhador_t *tarefa_trab = NULL;
+
+
+static inline uint64_t tarefa_agora(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/* Tarefa em execução na Thread atual, NULL fora de uma tarefa */
+static inline tarefa_t *tarefa_atual(void)
+{
+    return tarefa_trab ? tarefa_trab->atual : NULL;
+}
+
+static inline void tarefa_fila_insere(tarefa_fila_t *f, tarefa_espera_t *e)
+{
+    e->prox = NULL;
+    if (f->ultimo)
+        f->ultimo->prox = e;
+    else
+        f->primeiro = e;
+    f->ultimo = e;
+}
+
+static inline tarefa_espera_t *tarefa_fila_remove(tarefa_fila_t *f)
+{
+    tarefa_espera_t *e = f->primeiro;
+    if (e && !(f->primeiro = e->prox))
+        f->ultimo = NULL;
+    return e;
+}
+
+/* Coloca a tarefa na fila de prontas (com 'tarefas_trava') */
+static inline void tarefa_pronta_travado(tarefa_t *t)
+{
+    t->estado = TAREFA_PRONTA;
+    t->prox = NULL;
+    if (tarefas_ultima)
+        tarefas_ultima->prox = t;
+    else
+        tarefas_prontas = t;
+    tarefas_ultima = t;
+    pthread_cond_signal(&tarefas_cond);
+}
+
+static inline void tarefa_pronta(tarefa_t *t)
+{
+    pthread_mutex_lock(&tarefas_trava);
+    tarefa_pronta_travado(t);
+    pthread_mutex_unlock(&tarefas_trava);
+}
+
+/* Heap de tarefas dormindo (com 'tarefas_trava') */
+static inline void tarefa_dormindo_insere(tarefa_t *t)
+{
+    size_t i, pai, cap;
+    tarefa_t **novo;
+    if (tarefas_num_dormindo == tarefas_cap_dormindo)
+    {
+        cap = tarefas_cap_dormindo ? 2 * tarefas_cap_dormindo : 64;
+        /* Sem memória a tarefa não tem como dormir (nem como avisar quem chamou) */
+        if (!(novo = realloc(tarefas_dormindo, cap * sizeof(tarefa_t *))))
+        {
+            perror("tarefas: realloc");
+            abort();
+        }
+        tarefas_dormindo = novo;
+        tarefas_cap_dormindo = cap;
+    }
+    for (i = tarefas_num_dormindo++; i; i = pai)
+    {
+        pai = (i - 1) / 2;
+        if (tarefas_dormindo[pai]->prazo <= t->prazo)
+            break;
+        tarefas_dormindo[i] = tarefas_dormindo[pai];
+    }
+    tarefas_dormindo[i] = t;
+}
+
+static inline tarefa_t *tarefa_dormindo_remove(void)
+{
+    tarefa_t *topo = tarefas_dormindo[0], *ultima = tarefas_dormindo[--tarefas_num_dormindo];
+    size_t i = 0, filho;
+    while ((filho = 2 * i + 1) < tarefas_num_dormindo)
+    {
+        if (filho + 1 < tarefas_num_dormindo &&
+            tarefas_dormindo[filho + 1]->prazo < tarefas_dormindo[filho]->prazo)
+            filho++;
+        if (ultima->prazo <= tarefas_dormindo[filho]->prazo)
+            break;
+        tarefas_dormindo[i] = tarefas_dormindo[filho];
+        i = filho;
+    }
+    if (tarefas_num_dormindo)
+        tarefas_dormindo[i] = ultima;
+    return topo;
+}
+
+/*
+    Tira a tarefa atual da CPU e volta ao laço do trabalhador, que executa
+    'acao' somente depois do contexto salvo (quem acorda a tarefa precisa da
+    guarda, então não existe como retomar um contexto pela metade). Retorna
+    quando a tarefa for retomada, possivelmente em outro trabalhador.
+*/
+static inline void tarefa_estaciona(int acao, pthread_mutex_t *guarda)
+{
+    tarefa_trabalhador_t *w = tarefa_trab;
+    tarefa_t *t = w->atual;
+    t->estado = TAREFA_PARADA;
+    w->acao = acao;
+    w->guarda = guarda;
+    swapcontext(&t->contexto, &w->contexto);
+}
+
+static inline void tarefa_espera_inicia(tarefa_espera_t *e)
+{
+    e->prox = NULL;
+    if (!(e->tarefa = tarefa_atual()))
+        sem_init(&e->sinal, 0, 0);
+}
+
+/* Aguarda a vez com 'guarda' travada (a guarda é liberada), estaciona a tarefa ou bloqueia a Thread */
+static inline void tarefa_aguarda(tarefa_espera_t *e, pthread_mutex_t *guarda)
+{
+    if (e->tarefa)
+    {
+        tarefa_estaciona(TAREFA_ACAO_LIBERA, guarda);
+        return;
+    }
+    pthread_mutex_unlock(guarda);
+    while (sem_wait(&e->sinal))
+        ;
+    sem_destroy(&e->sinal);
+}
+
+/* Acorda quem espera (o registro some da pilha de quem acorda logo em seguida) */
+static inline void tarefa_acorda(tarefa_espera_t *e)
+{
+    tarefa_t *t = e->tarefa;
+    if (t)
+        tarefa_pronta(t);
+    else
+        sem_post(&e->sinal);
+}
+
+/* Trabalho do trabalhador após a tarefa sair da CPU */
+static inline void tarefa_depois(tarefa_trabalhador_t *w, tarefa_t *t)
+{
+    tarefa_espera_t *e;
+    switch (w->acao)
+    {
+    case TAREFA_ACAO_LIBERA:
+        pthread_mutex_unlock(w->guarda);
+        break;
+    case TAREFA_ACAO_DORME:
+        pthread_mutex_lock(&tarefas_trava);
+        tarefa_dormindo_insere(t);
+        /* Novo menor prazo, algum trabalhador dormindo precisa refazer o tempo */
+        if (tarefas_dormindo[0] == t)
+            pthread_cond_signal(&tarefas_cond);
+        pthread_mutex_unlock(&tarefas_trava);
+        break;
+    case TAREFA_ACAO_TERMINA:
+        pthread_mutex_lock(&tarefas_trava);
+        t->estado = TAREFA_TERMINADA;
+        e = t->junta;
+        tarefas_vivas--;
+        pthread_mutex_unlock(&tarefas_trava);
+        if (e)
+            tarefa_acorda(e);
+        break;
+    }
+}
+
+/* Laço de escalonamento de cada trabalhador */
+static void *tarefas_trabalhador(void *arg)
+{
+    tarefa_trabalhador_t w;
+    tarefa_t *t;
+    uint64_t agora;
+    struct timespec ts;
+
+    (void)arg;
+    w.atual = NULL;
+    tarefa_trab = &w;
+    while (1)
+    {
+        pthread_mutex_lock(&tarefas_trava);
+        while (1)
+        {
+            /* Prazos vencidos voltam para as prontas */
+            agora = tarefa_agora();
+            while (tarefas_num_dormindo && tarefas_dormindo[0]->prazo <= agora)
+                tarefa_pronta_travado(tarefa_dormindo_remove());
+            if (tarefas_prontas)
+                break;
+            if (tarefas_num_dormindo)
+            {
+                ts.tv_sec = tarefas_dormindo[0]->prazo / 1000000000ull;
+                ts.tv_nsec = tarefas_dormindo[0]->prazo % 1000000000ull;
+                pthread_cond_timedwait(&tarefas_cond, &tarefas_trava, &ts);
+            }
+            else
+                pthread_cond_wait(&tarefas_cond, &tarefas_trava);
+        }
+        t = tarefas_prontas;
+        if (!(tarefas_prontas = t->prox))
+            tarefas_ultima = NULL;
+        pthread_mutex_unlock(&tarefas_trava);
+
+        t->estado = TAREFA_EXECUTANDO;
+        w.atual = t;
+        atomic_fetch_add_explicit(&tarefas_trocas, 1, memory_order_relaxed);
+        swapcontext(&w.contexto, &t->contexto);
+        w.atual = NULL;
+        tarefa_depois(&w, t);
+    }
+    return NULL;
+}
+
+/* Cria os trabalhadores (uma vez, na primeira tarefa) */
+static void tarefas_inicia(void)
+{
+    pthread_condattr_t attr;
+    pthread_t trab;
+    const char *v;
+    size_t i;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&tarefas_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    tarefas_pagina = (size_t)sysconf(_SC_PAGESIZE);
+    tarefas_num_trab = TAREFAS_TRABALHADORES;
+    if ((v = getenv("TAREFAS_TRABALHADORES")))
+        tarefas_num_trab = strtoul(v, NULL, 10);
+    if (!tarefas_num_trab)
+        tarefas_num_trab = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    for (i = 0; i < tarefas_num_trab; i++)
+    {
+        pthread_create(&trab, NULL, tarefas_trabalhador, NULL);
+        pthread_detach(trab);
+    }
+}
+
+/* Encerra a tarefa atual com 'retorno' (fora de uma tarefa encerra a Thread) */
+static inline void tarefa_sai(void *retorno)
+{
+    tarefa_t *t = tarefa_atual();
+    if (!t)
+        pthread_exit(retorno);
+    t->retorno = retorno;
+    tarefa_estaciona(TAREFA_ACAO_TERMINA, NULL);
+    __builtin_unreachable();
+}
+
+/* Primeira função de toda tarefa */
+static void tarefa_inicio(void)
+{
+    tarefa_t *t = tarefa_atual();
+    tarefa_sai(t->funcao(t->arg));
+}
+
+/* Cria uma tarefa pronta (mesma assinatura do pthread_create, 'attr' ignorado) */
+static inline int tarefa_cria(tarefa_id_t *id, const pthread_attr_t *attr, void *(*funcao)(void *), void *arg)
+{
+    tarefa_t *t;
+
+    (void)attr;
+    pthread_once(&tarefas_once, tarefas_inicia);
+    if (!(t = calloc(1, sizeof(tarefa_t))))
+        return EAGAIN;
+    t->pilha = mmap(NULL, TAREFAS_TAM_PILHA + tarefas_pagina, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (t->pilha == MAP_FAILED)
+    {
+        free(t);
+        return EAGAIN;
+    }
+    /* Página de guarda, estouro da pilha falha em vez de corromper a vizinha */
+    mprotect(t->pilha, tarefas_pagina, PROT_NONE);
+
+    t->funcao = funcao;
+    t->arg = arg;
+    getcontext(&t->contexto);
+    t->contexto.uc_stack.ss_sp = t->pilha + tarefas_pagina;
+    t->contexto.uc_stack.ss_size = TAREFAS_TAM_PILHA;
+    t->contexto.uc_link = NULL;
+    makecontext(&t->contexto, tarefa_inicio, 0);
+    *id = t;
+
+    pthread_mutex_lock(&tarefas_trava);
+    tarefas_criadas++;
+    if (++tarefas_vivas > tarefas_pico)
+        tarefas_pico = tarefas_vivas;
+    tarefa_pronta_travado(t);
+    pthread_mutex_unlock(&tarefas_trava);
+    return 0;
+}
+
+/* Aguarda o fim da tarefa e libera sua pilha */
+static inline int tarefa_junta(tarefa_id_t t, void **retorno)
+{
+    tarefa_espera_t e;
+
+    pthread_mutex_lock(&tarefas_trava);
+    if (t->estado != TAREFA_TERMINADA)
+    {
+        tarefa_espera_inicia(&e);
+        t->junta = &e;
+        tarefa_aguarda(&e, &tarefas_trava);
+    }
+    else
+        pthread_mutex_unlock(&tarefas_trava);
+
+    if (retorno)
+        *retorno = t->retorno;
+    munmap(t->pilha, TAREFAS_TAM_PILHA + tarefas_pagina);
+    free(t);
+    return 0;
+}
+
+/* Trava, a posse passa direto para a primeira da fila no unlock */
+static inline int tarefa_mutex_init(tarefa_mutex_t *m, const pthread_mutexattr_t *attr)
+{
+    (void)attr;
+    pthread_mutex_init(&m->guarda, NULL);
+    m->travada = 0;
+    m->espera.primeiro = m->espera.ultimo = NULL;
+    return 0;
+}
+
+static inline int tarefa_mutex_destroy(tarefa_mutex_t *m)
+{
+    return pthread_mutex_destroy(&m->guarda);
+}
+
+static inline int tarefa_mutex_lock(tarefa_mutex_t *m)
+{
+    tarefa_espera_t e;
+
+    pthread_mutex_lock(&m->guarda);
+    if (!m->travada)
+    {
+        m->travada = 1;
+        pthread_mutex_unlock(&m->guarda);
+        return 0;
+    }
+    tarefa_espera_inicia(&e);
+    tarefa_fila_insere(&m->espera, &e);
+    tarefa_aguarda(&e, &m->guarda);
+    return 0;
+}
+
+static inline int tarefa_mutex_unlock(tarefa_mutex_t *m)
+{
+    tarefa_espera_t *e;
+
+    pthread_mutex_lock(&m->guarda);
+    if (!(e = tarefa_fila_remove(&m->espera)))
+        m->travada = 0;
+    pthread_mutex_unlock(&m->guarda);
+    if (e)
+        tarefa_acorda(e);
+    return 0;
+}
+
+static inline int tarefa_cond_init(tarefa_cond_t *c, const pthread_condattr_t *attr)
+{
+    (void)attr;
+    pthread_mutex_init(&c->guarda, NULL);
+    c->espera.primeiro = c->espera.ultimo = NULL;
+    return 0;
+}
+
+static inline int tarefa_cond_destroy(tarefa_cond_t *c)
+{
+    return pthread_mutex_destroy(&c->guarda);
+}
+
+/* Entra na fila da condicional antes de soltar 'm' (não perde o sinal) */
+static inline int tarefa_cond_wait(tarefa_cond_t *c, tarefa_mutex_t *m)
+{
+    tarefa_espera_t e;
+
+    tarefa_espera_inicia(&e);
+    pthread_mutex_lock(&c->guarda);
+    tarefa_fila_insere(&c->espera, &e);
+    tarefa_mutex_unlock(m);
+    tarefa_aguarda(&e, &c->guarda);
+    return tarefa_mutex_lock(m);
+}
+
+static inline int tarefa_cond_signal(tarefa_cond_t *c)
+{
+    tarefa_espera_t *e;
+
+    pthread_mutex_lock(&c->guarda);
+    e = tarefa_fila_remove(&c->espera);
+    pthread_mutex_unlock(&c->guarda);
+    if (e)
+        tarefa_acorda(e);
+    return 0;
+}
+
+static inline int tarefa_cond_broadcast(tarefa_cond_t *c)
+{
+    tarefa_espera_t *e, *prox;
+
+    pthread_mutex_lock(&c->guarda);
+    e = c->espera.primeiro;
+    c->espera.primeiro = c->espera.ultimo = NULL;
+    pthread_mutex_unlock(&c->guarda);
+    for (; e; e = prox)
+    {
+        prox = e->prox;
+        tarefa_acorda(e);
+    }
+    return 0;
+}
+
+/* Semáforo, o post entrega a unidade direto para a primeira da fila */
+static inline int tarefa_sem_init(tarefa_sem_t *s, int pshared, unsigned int valor)
+{
+    (void)pshared;
+    pthread_mutex_init(&s->guarda, NULL);
+    s->valor = valor;
+    s->espera.primeiro = s->espera.ultimo = NULL;
+    return 0;
+}
+
+static inline int tarefa_sem_destroy(tarefa_sem_t *s)
+{
+    return pthread_mutex_destroy(&s->guarda);
+}
+
+static inline int tarefa_sem_wait(tarefa_sem_t *s)
+{
+    tarefa_espera_t e;
+
+    pthread_mutex_lock(&s->guarda);
+    if (s->valor)
+    {
+        s->valor--;
+        pthread_mutex_unlock(&s->guarda);
+        return 0;
+    }
+    tarefa_espera_inicia(&e);
+    tarefa_fila_insere(&s->espera, &e);
+    tarefa_aguarda(&e, &s->guarda);
+    return 0;
+}
+
+static inline int tarefa_sem_post(tarefa_sem_t *s)
+{
+    tarefa_espera_t *e;
+
+    pthread_mutex_lock(&s->guarda);
+    if (!(e = tarefa_fila_remove(&s->espera)))
+        s->valor++;
+    pthread_mutex_unlock(&s->guarda);
+    if (e)
+        tarefa_acorda(e);
+    return 0;
+}
+
+/* Espera por tempo, dentro de uma tarefa estaciona até o prazo (mesma assinatura do clock_nanosleep) */
+static inline int tarefa_clock_nanosleep(clockid_t relogio, int flags, const struct timespec *t,
+                                         struct timespec *resto)
+{
+    tarefa_t *atual = tarefa_atual();
+    struct timespec r;
+    uint64_t agora, pedido;
+
+    if (!atual)
+        return clock_nanosleep(relogio, flags, t, resto);
+
+    agora = tarefa_agora();
+    pedido = (uint64_t)t->tv_sec * 1000000000ull + t->tv_nsec;
+    if (flags & TIMER_ABSTIME)
+    {
+        /* Prazo absoluto de outro relógio, convertido pela diferença para o monotônico */
+        if (relogio != CLOCK_MONOTONIC)
+        {
+            clock_gettime(relogio, &r);
+            pedido -= (uint64_t)r.tv_sec * 1000000000ull + r.tv_nsec;
+            pedido += agora;
+        }
+        atual->prazo = pedido;
+    }
+    else
+        atual->prazo = agora + pedido;
+
+    if (atual->prazo > agora)
+        tarefa_estaciona(TAREFA_ACAO_DORME, NULL);
+    return 0;
+}
+
+/* Imprime trabalhadores e totais de tarefas */
+static inline void tarefas_relatorio(void)
+{
+    pthread_mutex_lock(&tarefas_trava);
+    printf("Tarefas: trabalhadores %zu, criadas %zu, pico vivas %zu, trocas de contexto %lu, pilha %u KiB\n",
+           tarefas_num_trab, tarefas_criadas, tarefas_pico, atomic_load(&tarefas_trocas),
+           (unsigned)(TAREFAS_TAM_PILHA / 1024));
+    pthread_mutex_unlock(&tarefas_trava);
+}
+
+/* Redirecionamento do restante do programa para as tarefas */
+#define pthread_t               tarefa_id_t
+#define pthread_create          tarefa_cria
+#define pthread_join            tarefa_junta
+#define pthread_exit            tarefa_sai
+#define pthread_mutex_t         tarefa_mutex_t
+#define pthread_mutex_init      tarefa_mutex_init
+#define pthread_mutex_destroy   tarefa_mutex_destroy
+#define pthread_mutex_lock      tarefa_mutex_lock
+#define pthread_mutex_unlock    tarefa_mutex_unlock
+#define pthread_cond_t          tarefa_cond_t
+#define pthread_cond_init       tarefa_cond_init
+#define pthread_cond_destroy    tarefa_cond_destroy
+#define pthread_cond_wait       tarefa_cond_wait
+#define pthread_cond_signal     tarefa_cond_signal
+#define pthread_cond_broadcast  tarefa_cond_broadcast
+#define sem_t                   tarefa_sem_t
+#define sem_init                tarefa_sem_init
+#define sem_destroy             tarefa_sem_destroy
+#define sem_wait                tarefa_sem_wait
+#define sem_post                tarefa_sem_post
+#define clock_nanosleep         tarefa_clock_nanosleep
+
+#endif